@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// Lock-free latency histogram with fixed, roughly logarithmic millisecond
+// buckets. Percentiles are reported as the upper bound of the bucket they fall in.
+class LatencyHistogram {
+public:
+    LatencyHistogram() = default;
+
+    void Record(double ms);
+
+    uint64_t Count() const;
+    double Percentile(double p) const;
+
+    // {"count", "mean_ms", "max_ms", "p50_ms", "p90_ms", "p99_ms", "buckets": [{"le_ms", "count"}]}
+    nlohmann::json ToJson() const;
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+private:
+    static constexpr size_t BUCKET_COUNT = 16;
+    // Upper bounds in ms, the last bucket catches everything above
+    static constexpr std::array<double, BUCKET_COUNT - 1> BUCKET_BOUNDS = {
+        1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 60000
+    };
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    // Sum and max in microseconds
+    std::atomic<uint64_t> sum_us_{0};
+    std::atomic<uint64_t> max_us_{0};
+};
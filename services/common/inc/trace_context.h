@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Per-request trace carried between services in the "trace" field of MQTT
+// payloads. Stage timestamps are CLOCK_MONOTONIC microseconds, which are only
+// comparable between processes on the same host (all services run on one Pi).
+class TraceContext {
+public:
+    // New trace with a random id
+    static TraceContext Start();
+    // Trace from a payload's "trace" field, an inactive trace if absent or malformed
+    static TraceContext FromJson(const nlohmann::json& payload);
+
+    static int64_t NowMicros();
+
+    bool Active() const;
+    const std::string& Id() const;
+
+    // Record that a stage completed now
+    void Mark(const std::string& stage);
+    // Milliseconds between two stages, negative if either is missing
+    double ElapsedMs(const std::string& from, const std::string& to) const;
+
+    // {"id": "...", "stages": [["wake_word", 123], ...]}
+    nlohmann::json ToJson() const;
+    // Stage durations for logging, e.g. "wake_word->intent 512.3ms, ..."
+    std::string Summary() const;
+
+private:
+    std::string id_;
+    std::vector<std::pair<std::string, int64_t>> stages_;
+
+    int64_t StageTime(const std::string& stage) const;
+};
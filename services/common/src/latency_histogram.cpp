@@ -0,0 +1,71 @@
+#include "latency_histogram.h"
+#include <algorithm>
+
+void LatencyHistogram::Record(double ms) {
+    ms = std::max(ms, 0.0);
+    size_t bucket = std::lower_bound(BUCKET_BOUNDS.begin(), BUCKET_BOUNDS.end(), ms) - BUCKET_BOUNDS.begin();
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    const auto us = static_cast<uint64_t>(ms * 1000.0);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = max_us_.load(std::memory_order_relaxed);
+    while (us > max && !max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::Count() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Percentile(double p) const {
+    std::array<uint64_t, BUCKET_COUNT> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    const double max_ms = max_us_.load(std::memory_order_relaxed) / 1000.0;
+    const auto rank = static_cast<uint64_t>(std::max(1.0, p * static_cast<double>(total)));
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < BUCKET_COUNT - 1; ++i) {
+        cumulative += counts[i];
+        if (cumulative >= rank) {
+            // The bucket bound can overshoot the largest value actually seen
+            return std::min(BUCKET_BOUNDS[i], max_ms);
+        }
+    }
+    return max_ms;
+}
+
+nlohmann::json LatencyHistogram::ToJson() const {
+    const uint64_t count = Count();
+    nlohmann::json buckets = nlohmann::json::array();
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        uint64_t bucket_count = buckets_[i].load(std::memory_order_relaxed);
+        if (bucket_count == 0) {
+            continue;
+        }
+        nlohmann::json bucket = {{"count", bucket_count}};
+        if (i < BUCKET_BOUNDS.size()) {
+            bucket["le_ms"] = BUCKET_BOUNDS[i];
+        } else {
+            bucket["le_ms"] = "inf";
+        }
+        buckets.push_back(bucket);
+    }
+
+    return {
+        {"count", count},
+        {"mean_ms", count ? sum_us_.load(std::memory_order_relaxed) / 1000.0 / count : 0.0},
+        {"max_ms", max_us_.load(std::memory_order_relaxed) / 1000.0},
+        {"p50_ms", Percentile(0.50)},
+        {"p90_ms", Percentile(0.90)},
+        {"p99_ms", Percentile(0.99)},
+        {"buckets", buckets}
+    };
+}
@@ -0,0 +1,92 @@
+#include "trace_context.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+TraceContext TraceContext::Start() {
+    static thread_local std::mt19937_64 rng{std::random_device{}()};
+    char id[17];
+    std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(rng()));
+
+    TraceContext trace;
+    trace.id_ = id;
+    return trace;
+}
+
+TraceContext TraceContext::FromJson(const nlohmann::json& payload) {
+    TraceContext trace;
+    if (!payload.is_object() || !payload.contains("trace")) {
+        return trace;
+    }
+
+    try {
+        const auto& json = payload.at("trace");
+        trace.id_ = json.at("id").get<std::string>();
+        for (const auto& stage : json.at("stages")) {
+            trace.stages_.emplace_back(stage.at(0).get<std::string>(), stage.at(1).get<int64_t>());
+        }
+    } catch (const nlohmann::json::exception&) {
+        return TraceContext();
+    }
+    return trace;
+}
+
+int64_t TraceContext::NowMicros() {
+    // steady_clock is CLOCK_MONOTONIC on Linux
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool TraceContext::Active() const {
+    return !id_.empty();
+}
+
+const std::string& TraceContext::Id() const {
+    return id_;
+}
+
+void TraceContext::Mark(const std::string& stage) {
+    if (Active()) {
+        stages_.emplace_back(stage, NowMicros());
+    }
+}
+
+double TraceContext::ElapsedMs(const std::string& from, const std::string& to) const {
+    int64_t start = StageTime(from);
+    int64_t end = StageTime(to);
+    if (start < 0 || end < 0) {
+        return -1.0;
+    }
+    return (end - start) / 1000.0;
+}
+
+nlohmann::json TraceContext::ToJson() const {
+    nlohmann::json stages = nlohmann::json::array();
+    for (const auto& [stage, time] : stages_) {
+        stages.push_back({stage, time});
+    }
+    return {{"id", id_}, {"stages", stages}};
+}
+
+std::string TraceContext::Summary() const {
+    std::string summary;
+    for (size_t i = 1; i < stages_.size(); ++i) {
+        char duration[32];
+        std::snprintf(duration, sizeof(duration), " %.1fms",
+                      (stages_[i].second - stages_[i - 1].second) / 1000.0);
+        if (!summary.empty()) {
+            summary += ", ";
+        }
+        summary += stages_[i - 1].first + "->" + stages_[i].first + duration;
+    }
+    return summary;
+}
+
+int64_t TraceContext::StageTime(const std::string& stage) const {
+    for (const auto& [name, time] : stages_) {
+        if (name == stage) {
+            return time;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,166 @@
+// Offline benchmark for the keyword pipeline. Replays recorded sessions through
+// the same VAD -> Porcupine -> Rhino path Core runs, as fast as possible.
+//
+// Usage: keyword_benchmark [--no-vad] [--repeat N] <session.wav>[=<expected wake words>] ...
+//
+// Needs PICOVOICE_ACCESS_KEY, and KEYWORD_CONFIG if the default model paths don't apply.
+
+#include "file_audio_source.h"
+#include "keyword_detector.h"
+#include "log.h"
+#include "voice_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Session {
+    std::string path;
+    // -1 when not given, the session then only counts towards throughput
+    int expected = -1;
+};
+
+struct SessionResult {
+    size_t frames = 0;
+    int wake_words = 0;
+    int intents = 0;
+    int understood = 0;
+};
+
+double PercentileUs(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+DetectorConfig LoadDetectorConfig() {
+    const char* path = std::getenv("KEYWORD_CONFIG");
+    if (!path || !*path) {
+        return DetectorConfig::Default();
+    }
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open keyword config: " + std::string(path));
+    }
+    return DetectorConfig::FromJson(nlohmann::json::parse(file));
+}
+
+void Usage(const char* argv0) {
+    std::fprintf(stderr, "Usage: %s [--no-vad] [--repeat N] <session.wav>[=<expected wake words>] ...\n", argv0);
+}
+
+}
+
+int main(int argc, char** argv) {
+    VoicePipelineConfig pipeline_config = VoicePipelineConfig::FromEnv();
+    int repeat = 1;
+    std::vector<Session> sessions;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--no-vad") {
+            pipeline_config.vad_enabled = false;
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg.rfind("--", 0) == 0) {
+            Usage(argv[0]);
+            return 1;
+        } else {
+            Session session;
+            size_t eq = arg.rfind('=');
+            session.path = arg.substr(0, eq);
+            if (eq != std::string::npos) {
+                session.expected = std::atoi(arg.c_str() + eq + 1);
+            }
+            sessions.push_back(session);
+        }
+    }
+    if (sessions.empty()) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const DetectorConfig detector_config = LoadDetectorConfig();
+        std::vector<int16_t> frame(AudioFrameRing::FRAME_SAMPLES);
+        std::vector<double> frame_us;
+
+        size_t total_frames = 0;
+        int hits = 0;
+        int misses = 0;
+        int false_alarms = 0;
+        double total_audio_s = 0.0;
+        double total_wall_s = 0.0;
+
+        for (const auto& session : sessions) {
+            FileAudioSource source(session.path);
+
+            for (int run = 0; run < repeat; ++run) {
+                // Fresh engines, VAD and command state per run so runs are independent.
+                // Porcupine has no reset, and Rhino may be left mid-command by the previous run.
+                KeywordDetector detector(detector_config);
+                VoicePipeline pipeline(detector, pipeline_config);
+                source.Rewind();
+                SessionResult result;
+
+                auto start = std::chrono::steady_clock::now();
+                while (source.CapturePorcupineFrame(frame.data(), frame.size())) {
+                    auto frame_start = std::chrono::steady_clock::now();
+                    VoiceEvent event = pipeline.ProcessFrame(frame.data());
+                    auto frame_end = std::chrono::steady_clock::now();
+                    frame_us.push_back(std::chrono::duration<double, std::micro>(frame_end - frame_start).count());
+
+                    result.frames++;
+                    if (event.type == VoiceEventType::WAKE_WORD) {
+                        result.wake_words++;
+                    }
+                    if (event.type == VoiceEventType::INTENT || event.has_intent) {
+                        result.intents++;
+                        result.understood += event.intent.status == IntentStatus::UNDERSTOOD;
+                    }
+                }
+                double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                total_frames += result.frames;
+                total_audio_s += source.DurationSeconds();
+                total_wall_s += wall_s;
+                if (session.expected >= 0) {
+                    hits += std::min(result.wake_words, session.expected);
+                    misses += std::max(0, session.expected - result.wake_words);
+                    false_alarms += std::max(0, result.wake_words - session.expected);
+                }
+
+                std::printf("%s run %d: %zu frames, %.2fx real time, %d wake words, %d/%d intents understood, "
+                            "%llu frames skipped by VAD\n",
+                            session.path.c_str(), run + 1, result.frames,
+                            wall_s > 0 ? source.DurationSeconds() / wall_s : 0.0,
+                            result.wake_words, result.understood, result.intents,
+                            static_cast<unsigned long long>(pipeline.SkippedFrames()));
+            }
+        }
+
+        std::sort(frame_us.begin(), frame_us.end());
+        std::printf("\nframes: %zu (%.1fs of audio in %.2fs)\n", total_frames, total_audio_s, total_wall_s);
+        std::printf("throughput: %.0f frames/s, %.1fx real time\n",
+                    total_wall_s > 0 ? total_frames / total_wall_s : 0.0,
+                    total_wall_s > 0 ? total_audio_s / total_wall_s : 0.0);
+        std::printf("per-frame latency: p50 %.1fus, p99 %.1fus, max %.1fus\n",
+                    PercentileUs(frame_us, 0.50), PercentileUs(frame_us, 0.99),
+                    frame_us.empty() ? 0.0 : frame_us.back());
+        std::printf("wake words: %d hits, %d misses, %d false alarms\n", hits, misses, false_alarms);
+    } catch (const std::exception& e) {
+        ERROR_LOG("Benchmark failed: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <alsa/asoundlib.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <memory>
+#include <nlohmann/json.hpp>
+
+#include "audio_source.h"
+#include "latency_histogram.h"
 
 enum class AudioMode {
     STEREO,
@@ -11,25 +18,70 @@ enum class AudioMode {
     MONO_RIGHT
 };
 
-class AudioCapture {
+struct AudioCaptureConfig {
+    std::string device = "plughw:1,0";
+    unsigned int rate = 16000;
+    // 1 for a mono device. With 2 the mode picks how the channels become mono.
+    unsigned int channels = 1;
+    AudioMode mode = AudioMode::MONO_MIX;
+    // Rounded up to a multiple of the 512-sample Porcupine frame
+    unsigned int period_frames = 512;
+    unsigned int buffer_periods = 4;
+    bool mmap = false;
+    // Give up on a read after this long without data
+    int poll_timeout_ms = 1000;
+
+    // AUDIO_DEVICE, AUDIO_CHANNELS, AUDIO_MODE (mono_mix|mono_left|mono_right),
+    // AUDIO_PERIOD_FRAMES, AUDIO_BUFFER_PERIODS, AUDIO_ACCESS (rw|mmap)
+    static AudioCaptureConfig FromEnv();
+};
+
+// ALSA capture. The device is opened non-blocking and reads wait in poll() for
+// a period to become available, so a stalled device times out instead of
+// hanging the capture thread.
+class AudioCapture : public AudioSource {
 private:
     std::unique_ptr<snd_pcm_t, decltype(&snd_pcm_close)> audio_capture_device_;
-    snd_pcm_hw_params_t *params_;
+    AudioCaptureConfig config_;
     unsigned int sample_rate_;
     unsigned int channels_;
     snd_pcm_format_t format_;
+    snd_pcm_uframes_t period_size_ = 0;
+    snd_pcm_uframes_t buffer_size_ = 0;
+
+    std::vector<struct pollfd> poll_fds_;
+    // Interleaved samples for multi-channel devices, mixed down to mono after the read
+    std::vector<int16_t> interleaved_;
+
+    std::atomic<uint64_t> overruns_{0};
+    std::atomic<uint64_t> poll_timeouts_{0};
+    // Time from detecting an overrun until audio flows again
+    LatencyHistogram recovery_latency_;
 
     void InitParams();
-    void PrintCurrentParameters();
+    void PrintCurrentParameters(snd_pcm_hw_params_t* params);
     void ResetCaptureDevice();
+    // Wait until the device has data, false on timeout
+    bool WaitForData();
+    snd_pcm_sframes_t Read(int16_t* buffer, snd_pcm_uframes_t frames);
+    void MixDown(const int16_t* interleaved, int16_t* mono, size_t frames) const;
 
 public:
-    AudioCapture(unsigned int rate = 16000, unsigned int chans = 1);
-    ~AudioCapture() = default;
+    // 512 frames = 32ms @ 16kHz
+    static constexpr size_t PORCUPINE_FRAME_LENGTH = 512;
+
+    explicit AudioCapture(const AudioCaptureConfig& config = AudioCaptureConfig::FromEnv());
+    ~AudioCapture() override = default;
 
-    std::vector<int16_t> CaptureAudio(unsigned int duration_ms);
-    std::vector<int16_t> CapturePorcupineFrame();
+    // Fill buffer with exactly samples mono frames, recovering from overruns without
+    // dropping the frame. Throws on unrecoverable device errors and poll timeouts,
+    // never runs out.
+    bool CapturePorcupineFrame(int16_t* buffer, size_t samples = PORCUPINE_FRAME_LENGTH) override;
+
+    uint64_t Overruns() const override;
+    // {"overruns", "poll_timeouts", "period_frames", "buffer_frames", "recovery": histogram}
+    nlohmann::json Metrics() const override;
 
     AudioCapture(const AudioCapture&) = delete;
     AudioCapture& operator=(const AudioCapture&) = delete;
-};
\ No newline at end of file
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Small int16 PCM kernels for the wake word path. NEON or SSE2 is used when
+// the target has it, with a scalar fallback producing identical results.
+namespace audio_dsp {
+
+// Mean of the samples, truncated toward zero
+int16_t Mean(const int16_t* samples, size_t count);
+
+// samples[i] = saturate((samples[i] - offset) * gain), in place
+void ApplyOffsetAndGain(int16_t* samples, size_t count, int16_t offset, float gain);
+
+// Remove the frame's DC offset and apply gain, in place
+void RemoveDcAndApplyGain(int16_t* samples, size_t count, float gain);
+
+}
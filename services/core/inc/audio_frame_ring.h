@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Preallocated single-producer/single-consumer ring of fixed-size audio frames.
+//
+// Push and pop never block or allocate. When the ring is full the incoming
+// frame is dropped (the frames already queued are kept, so the detector sees
+// contiguous audio) and the overrun counter is incremented.
+//
+// The consumer may sleep in WaitForFrame(). The producer only touches the
+// mutex when the consumer has announced it is about to sleep.
+class AudioFrameRing {
+public:
+    // 512 samples = 32ms @ 16kHz, one Porcupine/Rhino frame
+    static constexpr size_t FRAME_SAMPLES = 512;
+
+    // capacity is rounded up to a power of two
+    explicit AudioFrameRing(size_t capacity = 128);
+    ~AudioFrameRing() = default;
+
+    // Producer side. Copies a frame of FRAME_SAMPLES samples, returns false if
+    // the frame was dropped because the ring is full.
+    bool Push(const int16_t* samples);
+
+    // Producer side, zero-copy. Returns the next free slot or nullptr when full;
+    // CommitWrite() publishes it.
+    int16_t* AcquireWrite();
+    void CommitWrite();
+    // Account for a frame the producer had to discard
+    void RecordOverrun();
+
+    // Consumer side. Copies the oldest frame into samples, false if empty.
+    bool Pop(int16_t* samples);
+
+    // Consumer side, zero-copy. Returns the oldest frame or nullptr when empty;
+    // the slot stays valid until ReleaseRead() and may be modified in place.
+    int16_t* AcquireRead();
+    void ReleaseRead();
+
+    // Block the consumer until a frame is available, the ring is closed or the timeout expires
+    bool WaitForFrame(std::chrono::milliseconds timeout);
+
+    // Wake a sleeping consumer for shutdown, WaitForFrame() returns false afterwards
+    void Close();
+    void Clear();
+
+    size_t Size() const;
+    size_t Capacity() const;
+    uint64_t Overruns() const;
+
+    AudioFrameRing(const AudioFrameRing&) = delete;
+    AudioFrameRing& operator=(const AudioFrameRing&) = delete;
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<int16_t[]> samples_;
+
+    // Monotonic counters, written by one side only and kept on separate cache lines
+    alignas(CACHE_LINE) std::atomic<size_t> write_index_{0};
+    alignas(CACHE_LINE) std::atomic<size_t> read_index_{0};
+    alignas(CACHE_LINE) std::atomic<uint64_t> overruns_{0};
+
+    // Consumer parking
+    std::atomic<bool> consumer_waiting_{false};
+    std::atomic<bool> closed_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+
+    int16_t* Slot(size_t index) const;
+    void WakeConsumer();
+};
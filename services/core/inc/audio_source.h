@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// Source of 16kHz mono S16 audio for the keyword pipeline, either the ALSA
+// device (AudioCapture) or a recording (FileAudioSource).
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+
+    // Fill buffer with exactly samples frames. Returns false once the source is
+    // exhausted, throws on unrecoverable errors.
+    virtual bool CapturePorcupineFrame(int16_t* buffer, size_t samples) = 0;
+
+    // Number of overruns recovered from since start
+    virtual uint64_t Overruns() const { return 0; }
+
+    // Source specific telemetry for the metrics topic
+    virtual nlohmann::json Metrics() const { return nlohmann::json::object(); }
+};
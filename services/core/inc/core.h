@@ -2,17 +2,21 @@
 
 #include <thread>
 #include <atomic>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
 #include <memory>
 #include <string>
+#include <vector>
 #include <nlohmann/json.hpp>
 
 #include "audio_capture.h"
+#include "audio_frame_ring.h"
+#include "file_audio_source.h"
+#include "intent_router.h"
 #include "keyword_detector.h"
+#include "latency_histogram.h"
 #include "paho_mqtt_client.h"
 #include "service_interface.h"
+#include "trace_context.h"
+#include "voice_pipeline.h"
 
 using json = nlohmann::json;
 
@@ -36,30 +40,42 @@ private:
     // Constants
     static constexpr const char* STATUS_TOPIC = "home/services/core/status";
     static constexpr const char* COMMAND_TOPIC = "home/services/core/command"; // TODO: Implement
-    static constexpr const char* LED_MANAGER_COMMAND_TOPIC = "home/services/led_manager/command";
+    static constexpr const char* METRICS_TOPIC = "home/services/core/metrics";
+
+    // ~4s of audio between capture and detection before frames are dropped
+    static constexpr size_t AUDIO_RING_FRAMES = 128;
 
     // State
     std::atomic<bool> running_{true};
 
     // Audio processing
-    std::unique_ptr<AudioCapture> audio_capture_;
+    std::unique_ptr<AudioSource> audio_source_;
     std::unique_ptr<KeywordDetector> keyword_detector_;
-    std::queue<std::vector<int16_t>> audio_queue_;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
+    std::unique_ptr<VoicePipeline> voice_pipeline_;
+    IntentRouter intent_router_;
+    AudioFrameRing audio_ring_{AUDIO_RING_FRAMES};
+    // Sink for frames captured while the ring is full
+    std::vector<int16_t> capture_scratch_ = std::vector<int16_t>(AudioFrameRing::FRAME_SAMPLES);
     std::thread audio_thread_;
     std::thread audio_processing_thread_;
 
+    // Voice command latency, exported on METRICS_TOPIC
+    LatencyHistogram rhino_latency_;
+    LatencyHistogram route_latency_;
+
     // Thread management and IService interface implementation
     std::thread worker_thread_;
     void Run() override;
 
     // MQTT handling
     void IncomingMessage(const std::string& topic, const std::string& payload);
-    void PublishLEDManagerCommand(const std::string& command, const json& params);
+    void HandleIntent(const Intent& intent, TraceContext& trace);
     void HandleServiceStatus(const std::string& topic, const std::string& payload);
 
     // Audio processing loops
     void AudioCaptureLoop();
     void AudioProcessingLoop();
+    // Waits for the next frame and returns its ring slot, nullptr on timeout.
+    // The caller must ReleaseRead() the slot when done with it.
+    int16_t* NextAudioFrame();
 };
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Environment lookups, value is left untouched and false returned when the
+// variable is unset or doesn't parse.
+bool GetEnvVar(const std::string& name, std::string& value);
+bool GetEnvVar(const std::string& name, int& value);
+bool GetEnvVar(const std::string& name, unsigned int& value);
+bool GetEnvVar(const std::string& name, bool& value);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "audio_source.h"
+
+// Replays a recording as if it came from the microphone. Accepts 16-bit PCM
+// WAV files (16kHz, multi-channel input is mixed down to mono) or headerless
+// raw S16LE mono 16kHz files. The whole file is loaded up front so reads never
+// touch the disk.
+//
+// With realtime set frames are paced at the recording's rate, otherwise they
+// are returned as fast as they are consumed (benchmarks).
+class FileAudioSource : public AudioSource {
+public:
+    static constexpr unsigned int SAMPLE_RATE = 16000;
+    // Shorter recordings are rejected, they can't fill a single Porcupine frame
+    static constexpr size_t MIN_SAMPLES = 512;
+
+    explicit FileAudioSource(const std::string& path, bool realtime = false, bool loop = false);
+
+    bool CapturePorcupineFrame(int16_t* buffer, size_t samples) override;
+
+    // Start over from the beginning of the recording
+    void Rewind();
+
+    size_t TotalSamples() const;
+    double DurationSeconds() const;
+    const std::string& Path() const;
+
+private:
+    std::string path_;
+    bool realtime_;
+    bool loop_;
+    std::vector<int16_t> samples_;
+    size_t position_ = 0;
+    std::chrono::steady_clock::time_point next_frame_time_;
+    bool started_ = false;
+
+    void LoadWav(std::ifstream& file);
+    void LoadRaw(std::ifstream& file);
+};
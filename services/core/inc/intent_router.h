@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "keyword_detector.h"
+
+// Maps understood intents to MQTT commands so new voice commands only need a
+// config change. Routes are read from the "routes" array of the keyword config:
+//
+//   {"context": "smart_home", "intent": "changeState", "slots": {"state": "on"},
+//    "topic": "home/services/led_manager/command",
+//    "payload": {"command": "turn_on", "params": {}}}
+//
+// Every slot listed must match; the key "*" matches a value in any slot. String
+// values of the form "$slot" in the payload are replaced with that slot's value.
+// The first matching route wins.
+struct IntentRoute {
+    std::string context;
+    std::string intent;
+    std::map<std::string, std::string> slots;
+    std::string topic;
+    nlohmann::json payload;
+};
+
+class IntentRouter {
+public:
+    // Today's behaviour: changeState on/off drives the LED manager
+    static IntentRouter Default();
+    static IntentRouter FromJson(const nlohmann::json& config);
+
+    // Fills topic and payload for the first matching route, false if none match
+    bool Route(const Intent& intent, std::string& topic, nlohmann::json& payload) const;
+
+    size_t RouteCount() const;
+
+private:
+    std::vector<IntentRoute> routes_;
+
+    static bool Matches(const IntentRoute& route, const Intent& intent);
+    static nlohmann::json Substitute(const nlohmann::json& value, const Intent& intent);
+};
@@ -1,32 +1,92 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
+#include <map>
 #include <memory>
 #include <string>
+#include <nlohmann/json.hpp>
 #include <pv_porcupine.h>
 #include <pv_rhino.h>
 
-enum class Command {
+// A Rhino context, loaded once and reused for every command
+struct ContextConfig {
+    std::string name;
+    std::string path;
+    float sensitivity = 0.7f;
+    float endpoint_duration_sec = 0.5f;
+    bool require_endpoint = true;
+};
+
+// A Porcupine wake word and the context that handles the command following it
+struct KeywordConfig {
+    std::string name;
+    std::string path;
+    float sensitivity = 0.7f;
+    std::string context;
+};
+
+// Config file format (KEYWORD_CONFIG):
+// {
+//   "porcupine_model": "/usr/local/lib/core/porcupine_params.pv",
+//   "rhino_model": "/usr/local/lib/core/rhino_params.pv",
+//   "contexts": [{"name": "smart_home", "path": "...rhn", "sensitivity": 0.7,
+//                 "endpoint_duration_sec": 0.5, "require_endpoint": true}],
+//   "keywords": [{"name": "jarvis", "path": "...ppn", "sensitivity": 0.7, "context": "smart_home"}]
+// }
+struct DetectorConfig {
+    std::string porcupine_model_path = "/usr/local/lib/core/porcupine_params.pv";
+    std::string rhino_model_path = "/usr/local/lib/core/rhino_params.pv";
+    std::vector<ContextConfig> contexts;
+    std::vector<KeywordConfig> keywords;
+
+    // "jarvis" routed to the Smart Home context
+    static DetectorConfig Default();
+    static DetectorConfig FromJson(const nlohmann::json& config);
+};
+
+enum class IntentStatus {
     PROCESSING,
-    TURN_OFF,
-    TURN_ON,
-    NO_COMMAND
+    UNDERSTOOD,
+    NOT_UNDERSTOOD
+};
+
+struct Intent {
+    IntentStatus status = IntentStatus::PROCESSING;
+    std::string keyword;
+    std::string context;
+    std::string name;
+    std::map<std::string, std::string> slots;
 };
 
 class KeywordDetector {
 private:
+    using RhinoPtr = std::unique_ptr<pv_rhino_t, decltype(&pv_rhino_delete)>;
+
+    struct Context {
+        std::string name;
+        RhinoPtr rhino;
+    };
+
     std::unique_ptr<pv_porcupine_t, decltype(&pv_porcupine_delete)> porcupine_;
-    std::unique_ptr<pv_rhino_t, decltype(&pv_rhino_delete)> rhino_;
+    std::vector<Context> contexts_;
+    std::vector<std::string> keyword_names_;
+    // Index into contexts_ for each keyword
+    std::vector<size_t> keyword_contexts_;
 
 public:
-    explicit KeywordDetector(const std::string& porcupine_model_path = "/usr/local/lib/core/porcupine_params.pv",
-                             const std::string& porcupine_keyword_path = "/usr/local/lib/core/jarvis_raspberry-pi.ppn",
-                             const std::string& rhino_model_path = "/usr/local/lib/core/rhino_params.pv",
-                             const std::string& rhino_context_path = "/usr/local/lib/core/Smart-Home_en_raspberry-pi_v3_0_0.rhn");
+    explicit KeywordDetector(const DetectorConfig& config = DetectorConfig::Default());
+
+    // Both take one 512-sample frame. DetectWakeWord preprocesses the frame in place
+    // and returns the index of the detected keyword, -1 if none.
+    int32_t DetectWakeWord(int16_t* frame, size_t samples, bool verbose = false) const;
+    // Feed the command following keyword_index to that keyword's context
+    Intent DetectCommand(size_t keyword_index, const int16_t* frame, size_t samples, bool verbose = false);
 
-    bool DetectWakeWord(const std::vector<int16_t>& buffer, bool verbose = false) const;
-    Command DetectCommand(const std::vector<int16_t>& buffer, bool verbose = false);
+    size_t KeywordCount() const;
+    const std::string& KeywordName(size_t keyword_index) const;
 
     KeywordDetector(const KeywordDetector&) = delete;
     KeywordDetector& operator=(const KeywordDetector&) = delete;
-};
\ No newline at end of file
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Cheap energy and zero-crossing voice activity detector used to skip the
+// wake word engine during silence.
+//
+// The noise floor tracks the quietest recent frames: it drops immediately to a
+// quieter frame and creeps back up slowly, so a steady noise source (fan,
+// heating) is absorbed after a few seconds. A frame is speech when its RMS is
+// well above the floor, or moderately above it with a high zero-crossing rate
+// (unvoiced onsets such as "s" or "ch"). Activity is held for hangover_frames
+// after the last speech frame so word gaps don't cut the engine off.
+class VoiceActivityDetector {
+public:
+    explicit VoiceActivityDetector(size_t hangover_frames = 10,
+                                   float threshold_ratio = 3.0f,
+                                   float min_rms = 100.0f);
+
+    // Classify one frame, true while speech is active (including hangover)
+    bool Process(const int16_t* samples, size_t count);
+    bool IsActive() const;
+    void Reset();
+
+    float NoiseFloor() const;
+    float LastRms() const;
+
+private:
+    // Per-frame noise floor rise, ~2x in 4.5s at 32ms frames
+    static constexpr float NOISE_FLOOR_RISE = 1.005f;
+    static constexpr float UNVOICED_ZCR = 0.25f;
+
+    const size_t hangover_frames_;
+    const float threshold_ratio_;
+    const float min_rms_;
+
+    float noise_floor_ = 0.0f;
+    float last_rms_ = 0.0f;
+    size_t hangover_ = 0;
+};
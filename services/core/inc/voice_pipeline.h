@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "audio_frame_ring.h"
+#include "keyword_detector.h"
+#include "voice_activity_detector.h"
+
+struct VoicePipelineConfig {
+    bool vad_enabled = true;
+    // In 32ms frames
+    size_t vad_hangover_frames = 10;
+    size_t preroll_frames = 10;
+
+    // VAD_ENABLED, VAD_HANGOVER_MS, VAD_PREROLL_MS
+    static VoicePipelineConfig FromEnv();
+};
+
+enum class VoiceEventType {
+    NONE,
+    WAKE_WORD,
+    INTENT
+};
+
+struct VoiceEvent {
+    VoiceEventType type = VoiceEventType::NONE;
+    int32_t keyword = -1;
+    Intent intent;
+    // Set on a WAKE_WORD event whose command already ended within the audio replayed
+    // behind the keyword, intent holds it and no INTENT event follows
+    bool has_intent = false;
+};
+
+// The audio side of Core, independent of where frames come from: the VAD
+// gate, wake word detection and the command that follows it. Feed it frames
+// in order from a single thread.
+class VoicePipeline {
+public:
+    VoicePipeline(KeywordDetector& detector, const VoicePipelineConfig& config);
+
+    // Process one AudioFrameRing::FRAME_SAMPLES frame, which may be modified in place.
+    // After a WAKE_WORD event frames go to the keyword's context until an INTENT event,
+    // unless the WAKE_WORD event already has_intent.
+    VoiceEvent ProcessFrame(int16_t* frame);
+
+    bool ListeningForCommand() const;
+
+    uint64_t SkippedFrames() const;
+    uint64_t ProcessedFrames() const;
+
+    VoicePipeline(const VoicePipeline&) = delete;
+    VoicePipeline& operator=(const VoicePipeline&) = delete;
+
+private:
+    KeywordDetector& detector_;
+
+    // Voice activity gate in front of the wake word engine. Skipped frames are kept
+    // in a short pre-roll and replayed at speech onset so the keyword start isn't lost.
+    const bool vad_enabled_;
+    VoiceActivityDetector vad_;
+    AudioFrameRing preroll_;
+    const size_t preroll_frames_;
+    std::atomic<uint64_t> skipped_frames_{0};
+    std::atomic<uint64_t> processed_frames_{0};
+
+    // Keyword whose command is being listened for, -1 when waiting for a wake word
+    int32_t active_keyword_ = -1;
+
+    // Wake word detection behind the VAD gate, keyword index or -1. When the keyword
+    // fires inside the pre-roll, the audio after it (including frame) goes to the command
+    // and a command that ends there is returned in event.
+    int32_t DetectWakeWord(int16_t* frame, VoiceEvent& event);
+    // Feed one frame of command audio, true once the intent is final
+    bool FeedCommand(int32_t keyword, const int16_t* frame, Intent& intent);
+};
@@ -1,64 +1,152 @@
 #include "audio_capture.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <stdexcept>
+#include "env.h"
 #include "log.h"
 
 
-AudioCapture::AudioCapture(unsigned int rate, unsigned int chans)
-    : audio_capture_device_(nullptr, snd_pcm_close), params_(nullptr),
-      sample_rate_(rate), channels_(chans), format_(SND_PCM_FORMAT_S16_LE) {
-    INFO_LOG("Initializing audio capture with rate: " + std::to_string(rate) + " Hz, channels: " + std::to_string(chans));
+AudioCaptureConfig AudioCaptureConfig::FromEnv() {
+    AudioCaptureConfig config;
+    GetEnvVar("AUDIO_DEVICE", config.device);
+    GetEnvVar("AUDIO_CHANNELS", config.channels);
+    GetEnvVar("AUDIO_PERIOD_FRAMES", config.period_frames);
+    GetEnvVar("AUDIO_BUFFER_PERIODS", config.buffer_periods);
+
+    std::string mode;
+    if (GetEnvVar("AUDIO_MODE", mode)) {
+        if (mode == "mono_mix") {
+            config.mode = AudioMode::MONO_MIX;
+        } else if (mode == "mono_left") {
+            config.mode = AudioMode::MONO_LEFT;
+        } else if (mode == "mono_right") {
+            config.mode = AudioMode::MONO_RIGHT;
+        } else {
+            // The keyword engines only take mono, so there is no stereo passthrough
+            ERROR_LOG("Unsupported AUDIO_MODE: " + mode);
+            throw std::runtime_error("Unsupported AUDIO_MODE: " + mode);
+        }
+    }
+
+    std::string access;
+    if (GetEnvVar("AUDIO_ACCESS", access)) {
+        config.mmap = access == "mmap";
+    }
+    return config;
+}
+
+AudioCapture::AudioCapture(const AudioCaptureConfig& config)
+    : audio_capture_device_(nullptr, snd_pcm_close), config_(config),
+      sample_rate_(config.rate), channels_(config.channels), format_(SND_PCM_FORMAT_S16_LE) {
+    if (channels_ < 1 || channels_ > 2) {
+        throw std::runtime_error("Unsupported channel count: " + std::to_string(channels_));
+    }
+    if (channels_ == 2 && config_.mode == AudioMode::STEREO) {
+        throw std::runtime_error("Stereo capture needs a mono mixing mode");
+    }
+
+    // Align the period to whole Porcupine frames so each wakeup yields complete frames
+    const unsigned int frame = PORCUPINE_FRAME_LENGTH;
+    config_.period_frames = std::max(frame, (config_.period_frames + frame - 1) / frame * frame);
+    config_.buffer_periods = std::max(2u, config_.buffer_periods);
+
+    INFO_LOG("Initializing audio capture on " + config_.device + " with rate: " + std::to_string(sample_rate_) +
+             " Hz, channels: " + std::to_string(channels_) + ", period: " + std::to_string(config_.period_frames) +
+             " frames x " + std::to_string(config_.buffer_periods) + (config_.mmap ? ", mmap" : ", rw"));
     InitParams();
+
+    if (channels_ > 1) {
+        interleaved_.resize(PORCUPINE_FRAME_LENGTH * channels_);
+    }
 }
 
 void AudioCapture::InitParams() {
     snd_pcm_t *raw_device;
-    int rc = snd_pcm_open(&raw_device, "plughw:1,0", SND_PCM_STREAM_CAPTURE, 0);
+    int rc = snd_pcm_open(&raw_device, config_.device.c_str(), SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK);
     if (rc < 0) {
         ERROR_LOG("Cannot open audio device: " + std::string(snd_strerror(rc)));
         throw std::runtime_error("Cannot open audio device: " + std::string(snd_strerror(rc)));
     }
     audio_capture_device_.reset(raw_device);
+    snd_pcm_t* pcm = audio_capture_device_.get();
 
     // Init parameters
-    snd_pcm_hw_params_alloca(&params_);
-    snd_pcm_hw_params_any(audio_capture_device_.get(), params_);
+    snd_pcm_hw_params_t *params;
+    snd_pcm_hw_params_alloca(&params);
+    snd_pcm_hw_params_any(pcm, params);
 
     // Set parameters
-    rc = snd_pcm_hw_params_set_access(audio_capture_device_.get(), params_, SND_PCM_ACCESS_RW_INTERLEAVED);
-    if (rc < 0) ERROR_LOG("Cannot set access type: " + std::string(snd_strerror(rc)));
-    
-    rc = snd_pcm_hw_params_set_format(audio_capture_device_.get(), params_, format_);
+    snd_pcm_access_t access = config_.mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED;
+    rc = snd_pcm_hw_params_set_access(pcm, params, access);
+    if (rc < 0) {
+        ERROR_LOG("Cannot set access type: " + std::string(snd_strerror(rc)));
+        throw std::runtime_error("Cannot set access type: " + std::string(snd_strerror(rc)));
+    }
+
+    rc = snd_pcm_hw_params_set_format(pcm, params, format_);
     if (rc < 0) ERROR_LOG("Cannot set sample format: " + std::string(snd_strerror(rc)));
-    
-    rc = snd_pcm_hw_params_set_channels(audio_capture_device_.get(), params_, channels_);
+
+    rc = snd_pcm_hw_params_set_channels(pcm, params, channels_);
     if (rc < 0) ERROR_LOG("Cannot set channel count: " + std::string(snd_strerror(rc)));
-    
-    rc = snd_pcm_hw_params_set_rate_near(audio_capture_device_.get(), params_, &sample_rate_, 0);
+
+    rc = snd_pcm_hw_params_set_rate_near(pcm, params, &sample_rate_, 0);
     if (rc < 0) ERROR_LOG("Cannot set sample rate: " + std::string(snd_strerror(rc)));
 
+    period_size_ = config_.period_frames;
+    rc = snd_pcm_hw_params_set_period_size_near(pcm, params, &period_size_, 0);
+    if (rc < 0) ERROR_LOG("Cannot set period size: " + std::string(snd_strerror(rc)));
+
+    buffer_size_ = period_size_ * config_.buffer_periods;
+    rc = snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer_size_);
+    if (rc < 0) ERROR_LOG("Cannot set buffer size: " + std::string(snd_strerror(rc)));
+
     // Apply parameters
-    rc = snd_pcm_hw_params(audio_capture_device_.get(), params_);
+    rc = snd_pcm_hw_params(pcm, params);
     if (rc < 0) {
         ERROR_LOG("Cannot set hardware parameters: " + std::string(snd_strerror(rc)));
         throw std::runtime_error("Cannot set hardware parameters: " + std::string(snd_strerror(rc)));
     }
+    snd_pcm_hw_params_get_period_size(params, &period_size_, nullptr);
+    snd_pcm_hw_params_get_buffer_size(params, &buffer_size_);
+    if (period_size_ % PORCUPINE_FRAME_LENGTH != 0) {
+        WARN_LOG("Device period of " + std::to_string(period_size_) + " frames is not a multiple of " +
+                 std::to_string(PORCUPINE_FRAME_LENGTH));
+    }
 
-    PrintCurrentParameters();
-    snd_pcm_prepare(audio_capture_device_.get());
+    // Wake poll() once per period
+    snd_pcm_sw_params_t *sw_params;
+    snd_pcm_sw_params_alloca(&sw_params);
+    snd_pcm_sw_params_current(pcm, sw_params);
+    snd_pcm_sw_params_set_avail_min(pcm, sw_params, period_size_);
+    rc = snd_pcm_sw_params(pcm, sw_params);
+    if (rc < 0) ERROR_LOG("Cannot set software parameters: " + std::string(snd_strerror(rc)));
+
+    PrintCurrentParameters(params);
+
+    int count = snd_pcm_poll_descriptors_count(pcm);
+    if (count <= 0) {
+        throw std::runtime_error("Audio device has no poll descriptors");
+    }
+    poll_fds_.resize(count);
+    snd_pcm_poll_descriptors(pcm, poll_fds_.data(), count);
+
+    // Capture doesn't start on its own when reads are driven by poll()
+    snd_pcm_prepare(pcm);
+    snd_pcm_start(pcm);
 }
 
-void AudioCapture::PrintCurrentParameters() {
-    snd_pcm_uframes_t buffer_size;
+void AudioCapture::PrintCurrentParameters(snd_pcm_hw_params_t* params) {
     unsigned int rate;
     snd_pcm_format_t format;
     unsigned int channels;
 
-    snd_pcm_hw_params_get_buffer_size(params_, &buffer_size);
-    snd_pcm_hw_params_get_rate(params_, &rate, nullptr);
-    snd_pcm_hw_params_get_format(params_, &format);
-    snd_pcm_hw_params_get_channels(params_, &channels);
+    snd_pcm_hw_params_get_rate(params, &rate, nullptr);
+    snd_pcm_hw_params_get_format(params, &format);
+    snd_pcm_hw_params_get_channels(params, &channels);
 
-    INFO_LOG("Buffer size: " + std::to_string(buffer_size) + " frames");
+    INFO_LOG("Period size: " + std::to_string(period_size_) + " frames");
+    INFO_LOG("Buffer size: " + std::to_string(buffer_size_) + " frames");
     INFO_LOG("Sample rate: " + std::to_string(rate) + " Hz");
     INFO_LOG("Format: " + std::string(snd_pcm_format_name(format)));
     INFO_LOG("Channels: " + std::to_string(channels));
@@ -67,53 +155,110 @@ void AudioCapture::PrintCurrentParameters() {
 void AudioCapture::ResetCaptureDevice() {
     snd_pcm_drop(audio_capture_device_.get());
     snd_pcm_prepare(audio_capture_device_.get());
-    snd_pcm_reset(audio_capture_device_.get());
+    int rc = snd_pcm_start(audio_capture_device_.get());
+    if (rc < 0) ERROR_LOG("Cannot restart capture: " + std::string(snd_strerror(rc)));
 }
 
-// TODO: Can this be removed?
-std::vector<int16_t> AudioCapture::CaptureAudio(unsigned int duration_ms) {
-    ResetCaptureDevice();
-
-    snd_pcm_uframes_t frames_to_read = (sample_rate_ * duration_ms) / 1000;
-    std::vector<int16_t> buffer(frames_to_read * channels_);
-
-    snd_pcm_sframes_t frames_read = 0;
-    while (frames_read < snd_pcm_sframes_t(frames_to_read)) {
-        snd_pcm_sframes_t rc = snd_pcm_readi(audio_capture_device_.get(), 
-                                            buffer.data() + frames_read * channels_, 
-                                            frames_to_read - frames_read);
-        if (rc == -EPIPE) {
-            WARN_LOG("Overrun occurred");
-            snd_pcm_prepare(audio_capture_device_.get());
-        } else if (rc < 0) {
-            ERROR_LOG("Error code: " + std::to_string(rc));
-            ERROR_LOG("Error description: " + std::string(snd_strerror(rc)));
-            throw std::runtime_error("Error from read: " + std::string(snd_strerror(rc)));
-        } else {
-            frames_read += rc;
-        }
+bool AudioCapture::WaitForData() {
+    int rc = poll(poll_fds_.data(), poll_fds_.size(), config_.poll_timeout_ms);
+    if (rc == 0) {
+        return false;
+    }
+    // Readable, an error (an xrun, which the read reports as -EPIPE) or EINTR,
+    // in which case the read just returns -EAGAIN
+    return true;
+}
+
+snd_pcm_sframes_t AudioCapture::Read(int16_t* buffer, snd_pcm_uframes_t frames) {
+    if (config_.mmap) {
+        return snd_pcm_mmap_readi(audio_capture_device_.get(), buffer, frames);
     }
-    return buffer;
+    return snd_pcm_readi(audio_capture_device_.get(), buffer, frames);
 }
 
-std::vector<int16_t> AudioCapture::CapturePorcupineFrame() {
-    // 512 frames = 32ms @ 16kHz
-    static constexpr int32_t PORCUPINE_FRAME_LENGTH = 512;
-    std::vector<int16_t> buffer(PORCUPINE_FRAME_LENGTH);
+void AudioCapture::MixDown(const int16_t* interleaved, int16_t* mono, size_t frames) const {
+    switch (config_.mode) {
+        case AudioMode::MONO_LEFT:
+            for (size_t i = 0; i < frames; ++i) mono[i] = interleaved[i * 2];
+            break;
+        case AudioMode::MONO_RIGHT:
+            for (size_t i = 0; i < frames; ++i) mono[i] = interleaved[i * 2 + 1];
+            break;
+        case AudioMode::MONO_MIX:
+        default:
+            for (size_t i = 0; i < frames; ++i) {
+                mono[i] = static_cast<int16_t>((interleaved[i * 2] + interleaved[i * 2 + 1]) / 2);
+            }
+            break;
+    }
+}
 
-    int rc = snd_pcm_readi(audio_capture_device_.get(), buffer.data(), PORCUPINE_FRAME_LENGTH);
+bool AudioCapture::CapturePorcupineFrame(int16_t* buffer, size_t samples) {
+    // Iterate instead of recursing, a device that keeps overrunning must not grow the stack
+    static constexpr int MAX_RECOVERIES = 10;
+    int recoveries = 0;
+    bool recovering = false;
+    std::chrono::steady_clock::time_point overrun_time;
 
-    if (rc == -EPIPE) {
-        WARN_LOG("Overrun occurred");
-        ResetCaptureDevice();
-        return CapturePorcupineFrame();
-    } else if (rc < 0) {
-        ERROR_LOG("Error from read: " + std::string(snd_strerror(rc)));
-        throw std::runtime_error("Failed to read audio");
-    } else if (rc != PORCUPINE_FRAME_LENGTH) {
-        ERROR_LOG("Short read, read " + std::to_string(rc) + " frames");
-        throw std::runtime_error("Short read");
+    // Multi-channel devices are read interleaved and mixed down once the frame is complete
+    if (channels_ > 1 && interleaved_.size() < samples * channels_) {
+        interleaved_.resize(samples * channels_);
     }
+    int16_t* destination = channels_ > 1 ? interleaved_.data() : buffer;
 
-    return buffer;
-}
\ No newline at end of file
+    size_t frames_read = 0;
+    while (frames_read < samples) {
+        snd_pcm_sframes_t rc = Read(destination + frames_read * channels_, samples - frames_read);
+        if (rc == -EPIPE || rc == -ESTRPIPE) {
+            overruns_++;
+            if (++recoveries > MAX_RECOVERIES) {
+                ERROR_LOG("Audio device keeps overrunning, giving up");
+                throw std::runtime_error("Failed to recover from overrun");
+            }
+            WARN_LOG("Overrun occurred (" + std::to_string(overruns_.load()) + " total)");
+            if (!recovering) {
+                recovering = true;
+                overrun_time = std::chrono::steady_clock::now();
+            }
+            // The partial frame is stale after an overrun, start it over
+            ResetCaptureDevice();
+            frames_read = 0;
+        } else if (rc == -EAGAIN || rc == -EINTR) {
+            // Drained whatever was buffered, sleep until the next period
+            if (!WaitForData()) {
+                poll_timeouts_++;
+                ERROR_LOG("Timed out waiting for audio from " + config_.device);
+                throw std::runtime_error("Timed out waiting for audio");
+            }
+        } else if (rc < 0) {
+            ERROR_LOG("Error from read: " + std::string(snd_strerror(rc)));
+            throw std::runtime_error("Failed to read audio");
+        } else {
+            frames_read += static_cast<size_t>(rc);
+            if (recovering && rc > 0) {
+                recovering = false;
+                recovery_latency_.Record(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - overrun_time).count());
+            }
+        }
+    }
+
+    if (channels_ > 1) {
+        MixDown(destination, buffer, samples);
+    }
+    return true;
+}
+
+uint64_t AudioCapture::Overruns() const {
+    return overruns_.load();
+}
+
+nlohmann::json AudioCapture::Metrics() const {
+    return {
+        {"overruns", overruns_.load()},
+        {"poll_timeouts", poll_timeouts_.load()},
+        {"period_frames", period_size_},
+        {"buffer_frames", buffer_size_},
+        {"recovery", recovery_latency_.ToJson()}
+    };
+}
@@ -0,0 +1,80 @@
+#include "audio_dsp.h"
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_DSP_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define AUDIO_DSP_SSE2 1
+#endif
+
+namespace audio_dsp {
+
+int16_t Mean(const int16_t* samples, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t i = 0;
+    int64_t sum = 0;
+#if defined(AUDIO_DSP_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 8 <= count; i += 8) {
+        acc = vpadalq_s16(acc, vld1q_s16(samples + i));
+    }
+    sum = vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+#elif defined(AUDIO_DSP_SSE2)
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(x, ones));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    sum = static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; ++i) {
+        sum += samples[i];
+    }
+    return static_cast<int16_t>(sum / static_cast<int64_t>(count));
+}
+
+void ApplyOffsetAndGain(int16_t* samples, size_t count, int16_t offset, float gain) {
+    size_t i = 0;
+#if defined(AUDIO_DSP_NEON)
+    const int32x4_t voffset = vdupq_n_s32(offset);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t x = vld1q_s16(samples + i);
+        int32x4_t lo = vsubq_s32(vmovl_s16(vget_low_s16(x)), voffset);
+        int32x4_t hi = vsubq_s32(vmovl_s16(vget_high_s16(x)), voffset);
+        // Float multiply and truncation match the scalar path exactly
+        lo = vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(lo), gain));
+        hi = vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(hi), gain));
+        vst1q_s16(samples + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+#elif defined(AUDIO_DSP_SSE2)
+    const __m128i voffset = _mm_set1_epi32(offset);
+    const __m128 vgain = _mm_set1_ps(gain);
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        // Sign-extend to 32 bits
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(lo, voffset)), vgain));
+        hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(hi, voffset)), vgain));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        int32_t adjusted = static_cast<int32_t>((samples[i] - offset) * gain);
+        samples[i] = static_cast<int16_t>(std::max(std::min(adjusted, 32767), -32768));
+    }
+}
+
+void RemoveDcAndApplyGain(int16_t* samples, size_t count, float gain) {
+    ApplyOffsetAndGain(samples, count, Mean(samples, count), gain);
+}
+
+}
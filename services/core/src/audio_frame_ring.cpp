@@ -0,0 +1,130 @@
+#include "audio_frame_ring.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+size_t RoundUpPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}
+
+AudioFrameRing::AudioFrameRing(size_t capacity)
+    : capacity_(RoundUpPowerOfTwo(std::max<size_t>(2, capacity))),
+      mask_(capacity_ - 1),
+      samples_(new int16_t[capacity_ * FRAME_SAMPLES]()) {
+}
+
+int16_t* AudioFrameRing::Slot(size_t index) const {
+    return samples_.get() + (index & mask_) * FRAME_SAMPLES;
+}
+
+bool AudioFrameRing::Push(const int16_t* samples) {
+    int16_t* slot = AcquireWrite();
+    if (!slot) {
+        RecordOverrun();
+        return false;
+    }
+    std::memcpy(slot, samples, FRAME_SAMPLES * sizeof(int16_t));
+    CommitWrite();
+    return true;
+}
+
+int16_t* AudioFrameRing::AcquireWrite() {
+    const size_t write = write_index_.load(std::memory_order_relaxed);
+    const size_t read = read_index_.load(std::memory_order_acquire);
+    if (write - read >= capacity_) {
+        return nullptr;
+    }
+    return Slot(write);
+}
+
+void AudioFrameRing::CommitWrite() {
+    write_index_.store(write_index_.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    if (consumer_waiting_.load(std::memory_order_seq_cst)) {
+        WakeConsumer();
+    }
+}
+
+void AudioFrameRing::RecordOverrun() {
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool AudioFrameRing::Pop(int16_t* samples) {
+    const int16_t* slot = AcquireRead();
+    if (!slot) {
+        return false;
+    }
+    std::memcpy(samples, slot, FRAME_SAMPLES * sizeof(int16_t));
+    ReleaseRead();
+    return true;
+}
+
+int16_t* AudioFrameRing::AcquireRead() {
+    const size_t read = read_index_.load(std::memory_order_relaxed);
+    const size_t write = write_index_.load(std::memory_order_acquire);
+    if (read == write) {
+        return nullptr;
+    }
+    return Slot(read);
+}
+
+void AudioFrameRing::ReleaseRead() {
+    read_index_.store(read_index_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool AudioFrameRing::WaitForFrame(std::chrono::milliseconds timeout) {
+    if (closed_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (Size() > 0) {
+        return true;
+    }
+
+    // Announce the sleep before re-checking so a concurrent commit either
+    // sees the flag or its frame is seen here
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    consumer_waiting_.store(true, std::memory_order_seq_cst);
+    bool ready = wait_cv_.wait_for(lock, timeout, [this] {
+        return closed_.load(std::memory_order_acquire) ||
+               write_index_.load(std::memory_order_seq_cst) != read_index_.load(std::memory_order_relaxed);
+    });
+    consumer_waiting_.store(false, std::memory_order_relaxed);
+
+    return ready && !closed_.load(std::memory_order_acquire);
+}
+
+void AudioFrameRing::WakeConsumer() {
+    // Taking the lock orders the notify after the consumer's predicate check
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    wait_cv_.notify_one();
+}
+
+void AudioFrameRing::Close() {
+    closed_.store(true, std::memory_order_release);
+    WakeConsumer();
+}
+
+void AudioFrameRing::Clear() {
+    // Consumer side, drops everything queued so far
+    read_index_.store(write_index_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+size_t AudioFrameRing::Size() const {
+    const size_t write = write_index_.load(std::memory_order_acquire);
+    const size_t read = read_index_.load(std::memory_order_acquire);
+    return write - read;
+}
+
+size_t AudioFrameRing::Capacity() const {
+    return capacity_;
+}
+
+uint64_t AudioFrameRing::Overruns() const {
+    return overruns_.load(std::memory_order_relaxed);
+}
@@ -1,4 +1,5 @@
 #include "core.h"
+#include "env.h"
 #include "log.h"
 #include <chrono>
 #include <fstream>
@@ -7,12 +8,47 @@
 
 using json = nlohmann::json;
 
+namespace {
+
+// AUDIO_SOURCE: unset or "alsa" for the microphone, otherwise a WAV/raw file replayed in real time
+std::unique_ptr<AudioSource> CreateAudioSource() {
+    std::string source = "alsa";
+    bool loop = false;
+    GetEnvVar("AUDIO_SOURCE", source);
+    GetEnvVar("AUDIO_SOURCE_LOOP", loop);
+    if (source == "alsa") {
+        return std::make_unique<AudioCapture>(AudioCaptureConfig::FromEnv());
+    }
+
+    INFO_LOG("Replaying audio from " + source);
+    return std::make_unique<FileAudioSource>(source, true, loop);
+}
+
+}
+
 
 Core::Core(const std::string& broker_address, const std::string& client_id, 
     const std::string& ca_path, const std::string& username, const std::string& password) 
     : PahoMqttClient(broker_address, client_id, ca_path, username, password),
-      audio_capture_(std::make_unique<AudioCapture>()),
-      keyword_detector_(std::make_unique<KeywordDetector>()) {
+      audio_source_(CreateAudioSource()) {
+
+    // Keywords, contexts and intent routes, built-in defaults unless KEYWORD_CONFIG is set
+    const char* keyword_config_path = std::getenv("KEYWORD_CONFIG");
+    if (keyword_config_path && *keyword_config_path) {
+        std::ifstream file(keyword_config_path);
+        if (!file) {
+            ERROR_LOG("Failed to open keyword config: " + std::string(keyword_config_path));
+            throw std::runtime_error("Failed to open keyword config");
+        }
+        json keyword_config = json::parse(file);
+        keyword_detector_ = std::make_unique<KeywordDetector>(DetectorConfig::FromJson(keyword_config));
+        intent_router_ = IntentRouter::FromJson(keyword_config);
+        INFO_LOG("Loaded keyword config from " + std::string(keyword_config_path));
+    } else {
+        keyword_detector_ = std::make_unique<KeywordDetector>();
+        intent_router_ = IntentRouter::Default();
+    }
+    voice_pipeline_ = std::make_unique<VoicePipeline>(*keyword_detector_, VoicePipelineConfig::FromEnv());
 
     SetMessageCallback([this](mqtt::const_message_ptr msg) {
         this->IncomingMessage(msg->get_topic(), msg->to_string());
@@ -33,30 +69,25 @@ void Core::AudioCaptureLoop() {
     
     while(running_) {
         try {
-            auto frame = audio_capture_->CapturePorcupineFrame();
+            // Capture straight into the next ring slot. If the detector has stalled and the
+            // ring is full, the device still has to be drained, so read into scratch and drop it.
+            int16_t* slot = audio_ring_.AcquireWrite();
+            int16_t* buffer = slot ? slot : capture_scratch_.data();
+            if (!audio_source_->CapturePorcupineFrame(buffer, AudioFrameRing::FRAME_SAMPLES)) {
+                INFO_LOG("Audio source exhausted, stopping capture");
+                break;
+            }
             if (!running_) break;
-            
-            // Log timing every 100 frames (roughly 3.2 seconds)
-            // frame_count++;
-            // if (frame_count % 100 == 0) {
-            //     auto now = std::chrono::steady_clock::now();
-            //     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            //         now - last_capture_time).count();
-            //     float fps = 100000.0f / duration;
-            //     DEBUG_LOG("Audio capture rate: " + std::to_string(fps) + " fps, Queue size: " 
-            //         + std::to_string(audio_queue_.size()));
-            //     last_capture_time = now;
-            // }
-            
-            {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                if (audio_queue_.size() > 125) {
-                    ERROR_LOG("Audio queue overflow! Queue size: " + std::to_string(audio_queue_.size()) 
-                        + " frames (" + std::to_string(audio_queue_.size() * 32) + "ms of audio)");
+
+            if (slot) {
+                audio_ring_.CommitWrite();
+            } else {
+                audio_ring_.RecordOverrun();
+                uint64_t overruns = audio_ring_.Overruns();
+                if (overruns == 1 || overruns % 100 == 0) {
+                    ERROR_LOG("Audio ring full, dropped " + std::to_string(overruns) + " frames so far");
                 }
-                audio_queue_.push(std::move(frame));
             }
-            audio_queue_cv_.notify_one();
         } catch (const std::exception& e) {
             ERROR_LOG("Exception in audio capture: " + std::string(e.what()));
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -68,15 +99,11 @@ void Core::AudioProcessingLoop() {
     // auto last_process_time = std::chrono::steady_clock::now();
     // int frame_count = 0;
 
+    // Frames are processed in place in their ring slot and released afterwards
+    TraceContext trace;
     while(running_) {
-        std::vector<int16_t> frame;
-        {
-            std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-            audio_queue_cv_.wait(lock, [this] { return !audio_queue_.empty() || !running_; });
-            if (!running_) break;
-            frame = std::move(audio_queue_.front());
-            audio_queue_.pop();
-        }
+        int16_t* frame = NextAudioFrame();
+        if (!frame) continue;
 
         // frame_count++;
         // if (frame_count % 100 == 0) {
@@ -88,46 +115,50 @@ void Core::AudioProcessingLoop() {
         //     last_process_time = now;
         // }
 
-        if (running_ && keyword_detector_->DetectWakeWord(frame, true)) {
-            INFO_LOG("Wake word detected! Listening for command...");
-
-            Command cmd = Command::PROCESSING;
-            while (cmd == Command::PROCESSING && running_) {
-                // Get next audio frame
-                std::vector<int16_t> next_frame;
-                {
-                    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-                    audio_queue_cv_.wait(lock, [this] { 
-                        return !audio_queue_.empty() || !running_; 
-                    });
-                    if (!running_) break;
-                    next_frame = std::move(audio_queue_.front());
-                    audio_queue_.pop();
-                }
-                
-                // Process the frame
-                cmd = keyword_detector_->DetectCommand(next_frame, true);
-            }
-            if (!running_) break;
-            
-            switch(cmd) {
-                case Command::TURN_ON:
-                    INFO_LOG("Command detected: TURN_ON");
-                    PublishLEDManagerCommand("turn_on", json::object());
-                    break;
-                case Command::TURN_OFF:
-                    INFO_LOG("Command detected: TURN_OFF");
-                    PublishLEDManagerCommand("turn_off", json::object());
-                    break;
-                case Command::NO_COMMAND:
-                default:
-                    WARN_LOG("No command detected");
-                    break;
-            }
+        VoiceEvent event = running_ ? voice_pipeline_->ProcessFrame(frame) : VoiceEvent{};
+        audio_ring_.ReleaseRead();
+
+        if (event.type == VoiceEventType::WAKE_WORD) {
+            INFO_LOG("Wake word " + keyword_detector_->KeywordName(event.keyword) + " detected! Listening for command...");
+            trace = TraceContext::Start();
+            trace.Mark("wake_word");
+        }
+        if (event.type == VoiceEventType::INTENT || event.has_intent) {
+            // Rhino has finalized, the endpoint wait is included in this stage
+            trace.Mark("intent");
+            rhino_latency_.Record(trace.ElapsedMs("wake_word", "intent"));
+            HandleIntent(event.intent, trace);
         }
     }
 }
 
+void Core::HandleIntent(const Intent& intent, TraceContext& trace) {
+    if (intent.status != IntentStatus::UNDERSTOOD) {
+        WARN_LOG("No command detected");
+        return;
+    }
+
+    std::string topic;
+    json payload;
+    if (!intent_router_.Route(intent, topic, payload)) {
+        WARN_LOG("No route for intent: " + intent.context + "/" + intent.name);
+        return;
+    }
+
+    INFO_LOG("Command detected: " + intent.name + ", publishing to " + topic + " (trace " + trace.Id() + ")");
+    trace.Mark("publish");
+    route_latency_.Record(trace.ElapsedMs("intent", "publish"));
+    payload["trace"] = trace.ToJson();
+    Publish(topic, payload);
+}
+
+int16_t* Core::NextAudioFrame() {
+    if (!audio_ring_.WaitForFrame(std::chrono::milliseconds(100)) || !running_) {
+        return nullptr;
+    }
+    return audio_ring_.AcquireRead();
+}
+
 void Core::Initialize() {
     INFO_LOG("Starting main worker thread");
     worker_thread_ = std::thread(&Core::Run, this);
@@ -144,7 +175,9 @@ void Core::Run() {
     audio_processing_thread_ = std::thread(&Core::AudioProcessingLoop, this);
 
     auto last_status_time = std::chrono::steady_clock::now();
+    auto last_metrics_time = std::chrono::steady_clock::now();
     const auto status_interval = std::chrono::seconds(5);
+    const auto metrics_interval = std::chrono::seconds(30);
 
     while (running_) {
 
@@ -152,6 +185,11 @@ void Core::Run() {
         if (now - last_status_time >= status_interval) {
             try {
                 nlohmann::json status_msg = {{"status", "online"}};
+                status_msg["audio_overruns"] = audio_ring_.Overruns();
+                status_msg["audio_queue_frames"] = audio_ring_.Size();
+                status_msg["capture_overruns"] = audio_source_->Overruns();
+                status_msg["vad_skipped_frames"] = voice_pipeline_->SkippedFrames();
+                status_msg["vad_processed_frames"] = voice_pipeline_->ProcessedFrames();
                 Publish(STATUS_TOPIC, status_msg);
             } catch (const std::exception& e) {
                 ERROR_LOG("Exception in status update: " + std::string(e.what()));
@@ -159,6 +197,20 @@ void Core::Run() {
             last_status_time = now;
         }
 
+        if (now - last_metrics_time >= metrics_interval) {
+            try {
+                nlohmann::json metrics_msg = {
+                    {"wake_word_to_intent", rhino_latency_.ToJson()},
+                    {"intent_to_publish", route_latency_.ToJson()},
+                    {"capture", audio_source_->Metrics()}
+                };
+                Publish(METRICS_TOPIC, metrics_msg);
+            } catch (const std::exception& e) {
+                ERROR_LOG("Exception in metrics update: " + std::string(e.what()));
+            }
+            last_metrics_time = now;
+        }
+
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 }   
@@ -167,13 +219,8 @@ void Core::Stop() {
     INFO_LOG("Stopping Core");
     running_ = false;
 
-    // Clear any pending audio data
-    {
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        std::queue<std::vector<int16_t>> empty;
-        std::swap(audio_queue_, empty);
-    }
-    audio_queue_cv_.notify_all();
+    // Wake the processing thread, pending audio is discarded
+    audio_ring_.Close();
     
     if (audio_processing_thread_.joinable()) audio_processing_thread_.join();
     if (audio_thread_.joinable()) audio_thread_.join();
@@ -197,14 +244,6 @@ void Core::IncomingMessage(const std::string& topic, const std::string& payload)
     }
 }
 
-void Core::PublishLEDManagerCommand(const std::string& command, const json& params) {
-    json message{{"command", command}, {"params", params}};
-    std::string topic = LED_MANAGER_COMMAND_TOPIC;
-
-    DEBUG_LOG("Publishing command: " + command + " to topic: " + topic);
-    Publish(topic, message);
-}
-
 void Core::HandleServiceStatus(const std::string& topic, const std::string& payload) {
     DEBUG_LOG("Service status update - Topic: " + topic + ", Payload: " + payload);
     // React to service status changes if necessary
@@ -0,0 +1,53 @@
+#include "env.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdlib>
+
+bool GetEnvVar(const std::string& name, std::string& value) {
+    const char* env_value = std::getenv(name.c_str());
+    if (env_value && *env_value) {
+        value = std::string(env_value);
+        return true;
+    }
+    return false;
+}
+
+bool GetEnvVar(const std::string& name, int& value) {
+    std::string str_value;
+    if (GetEnvVar(name, str_value)) {
+        try {
+            value = std::stoi(str_value);
+            return true;
+        } catch (const std::exception& e) {
+            ERROR_LOG("Error converting environment variable " + name + " to int: " + e.what());
+        }
+    }
+    return false;
+}
+
+bool GetEnvVar(const std::string& name, unsigned int& value) {
+    int int_value = 0;
+    if (GetEnvVar(name, int_value)) {
+        if (int_value >= 0) {
+            value = static_cast<unsigned int>(int_value);
+            return true;
+        }
+        ERROR_LOG("Environment variable " + name + " must not be negative");
+    }
+    return false;
+}
+
+bool GetEnvVar(const std::string& name, bool& value) {
+    std::string str_value;
+    if (GetEnvVar(name, str_value)) {
+        std::transform(str_value.begin(), str_value.end(), str_value.begin(), ::tolower);
+        if (str_value == "true" || str_value == "1" || str_value == "yes") {
+            value = true;
+            return true;
+        } else if (str_value == "false" || str_value == "0" || str_value == "no") {
+            value = false;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,157 @@
+#include "file_audio_source.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+uint32_t ReadLE32(const uint8_t* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint16_t ReadLE16(const uint8_t* bytes) {
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+bool HasWavExtension(const std::string& path) {
+    if (path.size() < 4) {
+        return false;
+    }
+    std::string ext = path.substr(path.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".wav";
+}
+
+}
+
+FileAudioSource::FileAudioSource(const std::string& path, bool realtime, bool loop)
+    : path_(path), realtime_(realtime), loop_(loop) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        ERROR_LOG("Cannot open audio file: " + path);
+        throw std::runtime_error("Cannot open audio file: " + path);
+    }
+
+    if (HasWavExtension(path)) {
+        LoadWav(file);
+    } else {
+        LoadRaw(file);
+    }
+
+    if (samples_.size() < MIN_SAMPLES) {
+        ERROR_LOG("Audio file is shorter than one frame: " + path);
+        throw std::runtime_error("Audio file is shorter than one frame: " + path);
+    }
+    INFO_LOG("Loaded " + path + ": " + std::to_string(DurationSeconds()) + "s of audio");
+}
+
+void FileAudioSource::LoadWav(std::ifstream& file) {
+    uint8_t riff[12];
+    if (!file.read(reinterpret_cast<char*>(riff), sizeof(riff)) ||
+        std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        throw std::runtime_error("Not a WAV file: " + path_);
+    }
+
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint32_t sample_rate = 0;
+    uint16_t bits = 0;
+    bool have_format = false;
+
+    uint8_t header[8];
+    while (file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        const uint32_t chunk_size = ReadLE32(header + 4);
+        if (std::memcmp(header, "fmt ", 4) == 0) {
+            std::vector<uint8_t> fmt(chunk_size);
+            if (chunk_size < 16 || !file.read(reinterpret_cast<char*>(fmt.data()), chunk_size)) {
+                throw std::runtime_error("Malformed WAV format chunk: " + path_);
+            }
+            format = ReadLE16(&fmt[0]);
+            channels = ReadLE16(&fmt[2]);
+            sample_rate = ReadLE32(&fmt[4]);
+            bits = ReadLE16(&fmt[14]);
+            have_format = true;
+        } else if (std::memcmp(header, "data", 4) == 0) {
+            // WAVE_FORMAT_EXTENSIBLE (0xFFFE) is accepted as long as it's 16-bit PCM
+            if (!have_format || (format != 1 && format != 0xFFFE) || bits != 16 || channels == 0) {
+                ERROR_LOG("Unsupported WAV format in " + path_ + ", expected 16-bit PCM");
+                throw std::runtime_error("Unsupported WAV format: " + path_);
+            }
+            if (sample_rate != SAMPLE_RATE) {
+                ERROR_LOG("Unsupported sample rate " + std::to_string(sample_rate) + " in " + path_);
+                throw std::runtime_error("Unsupported WAV sample rate: " + path_);
+            }
+
+            std::vector<int16_t> interleaved(chunk_size / sizeof(int16_t));
+            file.read(reinterpret_cast<char*>(interleaved.data()), interleaved.size() * sizeof(int16_t));
+            interleaved.resize(static_cast<size_t>(file.gcount()) / sizeof(int16_t));
+
+            // Mix down to mono
+            samples_.resize(interleaved.size() / channels);
+            for (size_t i = 0; i < samples_.size(); ++i) {
+                int32_t sum = 0;
+                for (size_t c = 0; c < channels; ++c) {
+                    sum += interleaved[i * channels + c];
+                }
+                samples_[i] = static_cast<int16_t>(sum / channels);
+            }
+            return;
+        } else {
+            // Chunks are padded to an even size
+            file.seekg(chunk_size + (chunk_size & 1), std::ios::cur);
+        }
+    }
+    throw std::runtime_error("WAV file has no data chunk: " + path_);
+}
+
+void FileAudioSource::LoadRaw(std::ifstream& file) {
+    file.seekg(0, std::ios::end);
+    const auto size = static_cast<size_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+    samples_.resize(size / sizeof(int16_t));
+    file.read(reinterpret_cast<char*>(samples_.data()), samples_.size() * sizeof(int16_t));
+}
+
+bool FileAudioSource::CapturePorcupineFrame(int16_t* buffer, size_t samples) {
+    if (position_ + samples > samples_.size()) {
+        // Looping can't help when a single frame is longer than the recording
+        if (!loop_ || samples > samples_.size()) {
+            return false;
+        }
+        position_ = 0;
+    }
+
+    if (realtime_) {
+        const auto frame_duration = std::chrono::microseconds(samples * 1000000 / SAMPLE_RATE);
+        if (!started_) {
+            next_frame_time_ = std::chrono::steady_clock::now();
+            started_ = true;
+        }
+        next_frame_time_ += frame_duration;
+        std::this_thread::sleep_until(next_frame_time_);
+    }
+
+    std::copy_n(samples_.begin() + position_, samples, buffer);
+    position_ += samples;
+    return true;
+}
+
+void FileAudioSource::Rewind() {
+    position_ = 0;
+    started_ = false;
+}
+
+size_t FileAudioSource::TotalSamples() const {
+    return samples_.size();
+}
+
+double FileAudioSource::DurationSeconds() const {
+    return static_cast<double>(samples_.size()) / SAMPLE_RATE;
+}
+
+const std::string& FileAudioSource::Path() const {
+    return path_;
+}
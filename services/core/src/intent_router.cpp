@@ -0,0 +1,107 @@
+#include "intent_router.h"
+#include "log.h"
+
+namespace {
+
+constexpr const char* LED_MANAGER_COMMAND_TOPIC = "home/services/led_manager/command";
+
+}
+
+IntentRouter IntentRouter::Default() {
+    IntentRouter router;
+    router.routes_.push_back({"smart_home", "changeState", {{"*", "on"}}, LED_MANAGER_COMMAND_TOPIC,
+                              {{"command", "turn_on"}, {"params", nlohmann::json::object()}}});
+    router.routes_.push_back({"smart_home", "changeState", {{"*", "off"}}, LED_MANAGER_COMMAND_TOPIC,
+                              {{"command", "turn_off"}, {"params", nlohmann::json::object()}}});
+    return router;
+}
+
+IntentRouter IntentRouter::FromJson(const nlohmann::json& config) {
+    IntentRouter router;
+    if (!config.contains("routes")) {
+        WARN_LOG("Keyword config has no routes, intents will be ignored");
+        return router;
+    }
+
+    for (const auto& entry : config.at("routes")) {
+        IntentRoute route;
+        route.context = entry.value("context", "");
+        route.intent = entry.at("intent").get<std::string>();
+        if (entry.contains("slots")) {
+            route.slots = entry.at("slots").get<std::map<std::string, std::string>>();
+        }
+        route.topic = entry.at("topic").get<std::string>();
+        route.payload = entry.at("payload");
+        router.routes_.push_back(route);
+    }
+    return router;
+}
+
+bool IntentRouter::Route(const Intent& intent, std::string& topic, nlohmann::json& payload) const {
+    for (const auto& route : routes_) {
+        if (Matches(route, intent)) {
+            topic = route.topic;
+            payload = Substitute(route.payload, intent);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t IntentRouter::RouteCount() const {
+    return routes_.size();
+}
+
+bool IntentRouter::Matches(const IntentRoute& route, const Intent& intent) {
+    // An empty context matches intents from any context
+    if (!route.context.empty() && route.context != intent.context) {
+        return false;
+    }
+    if (route.intent != intent.name) {
+        return false;
+    }
+
+    for (const auto& [slot, value] : route.slots) {
+        if (slot == "*") {
+            bool found = false;
+            for (const auto& intent_slot : intent.slots) {
+                if (intent_slot.second == value) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                return false;
+            }
+            continue;
+        }
+
+        auto it = intent.slots.find(slot);
+        if (it == intent.slots.end() || it->second != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+nlohmann::json IntentRouter::Substitute(const nlohmann::json& value, const Intent& intent) {
+    if (value.is_string()) {
+        const std::string& str = value.get_ref<const std::string&>();
+        if (str.size() > 1 && str[0] == '$') {
+            auto it = intent.slots.find(str.substr(1));
+            if (it != intent.slots.end()) {
+                return it->second;
+            }
+        }
+        return value;
+    }
+
+    if (value.is_structured()) {
+        nlohmann::json result = value;
+        for (auto& child : result) {
+            child = Substitute(child, intent);
+        }
+        return result;
+    }
+    return value;
+}
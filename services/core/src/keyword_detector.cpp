@@ -6,31 +6,100 @@
 #include <algorithm>
 #include <limits>
 #include "keyword_detector.h"
+#include "audio_dsp.h"
 #include "log.h"
 
-KeywordDetector::KeywordDetector(const std::string& porcupine_model_path,
-                                 const std::string& porcupine_keyword_path,
-                                 const std::string& rhino_model_path,
-                                 const std::string& rhino_context_path)
-    : porcupine_(nullptr, pv_porcupine_delete),
-      rhino_(nullptr, pv_rhino_delete) {
+DetectorConfig DetectorConfig::Default() {
+    DetectorConfig config;
+    config.contexts.push_back({"smart_home", "/usr/local/lib/core/Smart-Home_en_raspberry-pi_v3_0_0.rhn"});
+    config.keywords.push_back({"jarvis", "/usr/local/lib/core/jarvis_raspberry-pi.ppn", 0.7f, "smart_home"});
+    return config;
+}
+
+DetectorConfig DetectorConfig::FromJson(const nlohmann::json& json) {
+    DetectorConfig config;
+    config.porcupine_model_path = json.value("porcupine_model", config.porcupine_model_path);
+    config.rhino_model_path = json.value("rhino_model", config.rhino_model_path);
+
+    for (const auto& entry : json.at("contexts")) {
+        ContextConfig context;
+        context.name = entry.at("name").get<std::string>();
+        context.path = entry.at("path").get<std::string>();
+        context.sensitivity = entry.value("sensitivity", context.sensitivity);
+        context.endpoint_duration_sec = entry.value("endpoint_duration_sec", context.endpoint_duration_sec);
+        context.require_endpoint = entry.value("require_endpoint", context.require_endpoint);
+        config.contexts.push_back(context);
+    }
+
+    for (const auto& entry : json.at("keywords")) {
+        KeywordConfig keyword;
+        keyword.name = entry.at("name").get<std::string>();
+        keyword.path = entry.at("path").get<std::string>();
+        keyword.sensitivity = entry.value("sensitivity", keyword.sensitivity);
+        keyword.context = entry.at("context").get<std::string>();
+        config.keywords.push_back(keyword);
+    }
+
+    return config;
+}
+
+KeywordDetector::KeywordDetector(const DetectorConfig& config)
+    : porcupine_(nullptr, pv_porcupine_delete) {
+
+    if (config.keywords.empty()) {
+        throw std::runtime_error("No keywords configured");
+    }
 
-    // Porcupine - Wake word detection
     const char* access_key = std::getenv("PICOVOICE_ACCESS_KEY");
     if (access_key == nullptr) {
         throw std::runtime_error("PICOVOICE_ACCESS_KEY is not set");
     }
 
-    const char* p_model_path = porcupine_model_path.c_str();
-    const char* p_keyword_path = porcupine_keyword_path.c_str();
-    const float p_sensitivity = 0.7f;
+    // Rhino - Intent classification. Every context is initialized up front so
+    // switching between them after a wake word costs nothing.
+    for (const auto& context : config.contexts) {
+        pv_rhino_t* rhino_raw = nullptr;
+        pv_status_t rhino_status = pv_rhino_init(
+            access_key,
+            config.rhino_model_path.c_str(),
+            context.path.c_str(),
+            context.sensitivity,
+            context.endpoint_duration_sec,
+            context.require_endpoint,
+            &rhino_raw
+        );
+
+        if (rhino_status != PV_STATUS_SUCCESS) {
+            ERROR_LOG("Failed to initialize Rhino context: " + context.name);
+            throw std::runtime_error("Failed to initialize Rhino");
+        }
+        contexts_.push_back({context.name, RhinoPtr(rhino_raw, pv_rhino_delete)});
+    }
+
+    // Porcupine - Wake word detection, all keywords in one instance
+    std::vector<const char*> keyword_paths;
+    std::vector<float> sensitivities;
+    for (const auto& keyword : config.keywords) {
+        auto context = std::find_if(contexts_.begin(), contexts_.end(),
+            [&keyword](const Context& c) { return c.name == keyword.context; });
+        if (context == contexts_.end()) {
+            ERROR_LOG("Keyword " + keyword.name + " references unknown context: " + keyword.context);
+            throw std::runtime_error("Unknown Rhino context");
+        }
+
+        keyword_paths.push_back(keyword.path.c_str());
+        sensitivities.push_back(keyword.sensitivity);
+        keyword_names_.push_back(keyword.name);
+        keyword_contexts_.push_back(static_cast<size_t>(context - contexts_.begin()));
+    }
+
     pv_porcupine_t* porcupine_raw = nullptr;
     pv_status_t status = pv_porcupine_init(
         access_key,
-        p_model_path,
-        1, // Number of keywords
-        &p_keyword_path,
-        &p_sensitivity, 
+        config.porcupine_model_path.c_str(),
+        static_cast<int32_t>(keyword_paths.size()),
+        keyword_paths.data(),
+        sensitivities.data(),
         &porcupine_raw
     );
 
@@ -39,72 +108,56 @@ KeywordDetector::KeywordDetector(const std::string& porcupine_model_path,
     }
     porcupine_.reset(porcupine_raw);
 
-    // Rhino - Intent classification
-    const char* r_model_path = rhino_model_path.c_str();
-    const char* r_context_path = rhino_context_path.c_str();
-    const float r_sensitivity = 0.7f;
-    const float r_endpoint_duration_sec = 0.5f;
-    const bool r_require_endpoint = true;
-    pv_rhino_t* rhino_raw = nullptr;
-    pv_status_t rhino_status = pv_rhino_init(
-        access_key,
-        r_model_path,
-        r_context_path,
-        r_sensitivity,
-        r_endpoint_duration_sec,
-        r_require_endpoint,
-        &rhino_raw
-    );
-
-    if (rhino_status != PV_STATUS_SUCCESS) {
-        throw std::runtime_error("Failed to initialize Rhino");
-    }
-    rhino_.reset(rhino_raw);
+    INFO_LOG("Keyword detector loaded " + std::to_string(keyword_names_.size()) + " keywords and "
+             + std::to_string(contexts_.size()) + " contexts");
 }
 
-bool KeywordDetector::DetectWakeWord(const std::vector<int16_t>& buffer, bool verbose) const {
-    std::vector<int16_t> processed = buffer;
-    (void)verbose;
-    
-    // Remove DC offset
-    int32_t sum = 0;
-    for (const auto& sample : buffer) {
-        sum += sample;
+int32_t KeywordDetector::DetectWakeWord(int16_t* frame, size_t samples, bool verbose) const {
+    if (samples != static_cast<size_t>(pv_porcupine_frame_length())) {
+        ERROR_LOG("Unexpected frame length: " + std::to_string(samples));
+        return -1;
     }
-    int16_t offset = sum / buffer.size();
     
     // Apply DC offset removal and small gain
     const float gain = 1.5f;
-    for (auto& sample : processed) {
-        int32_t adjusted = (sample - offset) * gain;
-        sample = std::max(std::min(adjusted, 32767), -32768);
-    }
+    audio_dsp::RemoveDcAndApplyGain(frame, samples, gain);
 
     int32_t keyword_index = -1;
-    pv_porcupine_process(porcupine_.get(), processed.data(), &keyword_index);
+    pv_porcupine_process(porcupine_.get(), frame, &keyword_index);
     
-    if (keyword_index >= 0) {
-        INFO_LOG("Keyword detected!");
-        return true;
+    if (keyword_index >= 0 && verbose) {
+        INFO_LOG("Keyword detected: " + keyword_names_[keyword_index]);
     }
-    return false;
+    return keyword_index;
 }
 
-Command KeywordDetector::DetectCommand(const std::vector<int16_t>& buffer, bool verbose) {
+Intent KeywordDetector::DetectCommand(size_t keyword_index, const int16_t* frame, size_t samples, bool verbose) {
+    const Context& context = contexts_.at(keyword_contexts_.at(keyword_index));
+    pv_rhino_t* rhino = context.rhino.get();
+
+    Intent result;
+    result.keyword = keyword_names_[keyword_index];
+    result.context = context.name;
+
+    if (samples != static_cast<size_t>(pv_rhino_frame_length())) {
+        ERROR_LOG("Unexpected frame length: " + std::to_string(samples));
+        throw std::runtime_error("Unexpected frame length");
+    }
+
     bool is_finalized = false;
-    pv_status_t status = pv_rhino_process(rhino_.get(), buffer.data(), &is_finalized);
+    pv_status_t status = pv_rhino_process(rhino, frame, &is_finalized);
     if (status != PV_STATUS_SUCCESS) {
         ERROR_LOG("Failed to process audio in DetectCommand");
         throw std::runtime_error("Failed to process audio");
     }
     
     if (!is_finalized) {
-        return Command::PROCESSING;
+        return result;
     }
 
     // Check if command was understood
     bool is_understood = false;
-    status = pv_rhino_is_understood(rhino_.get(), &is_understood);
+    status = pv_rhino_is_understood(rhino, &is_understood);
     if (status != PV_STATUS_SUCCESS) {
         ERROR_LOG("Failed to check if command was understood");
         throw std::runtime_error("Failed to check command understanding");
@@ -112,8 +165,9 @@ Command KeywordDetector::DetectCommand(const std::vector<int16_t>& buffer, bool
 
     if (!is_understood) {
         DEBUG_LOG("Command not understood");
-        pv_rhino_reset(rhino_.get());
-        return Command::NO_COMMAND;
+        pv_rhino_reset(rhino);
+        result.status = IntentStatus::NOT_UNDERSTOOD;
+        return result;
     }
 
     // Extract intent and slots
@@ -121,7 +175,7 @@ Command KeywordDetector::DetectCommand(const std::vector<int16_t>& buffer, bool
     const char** slots = nullptr;
     const char** values = nullptr;
     int32_t num_slots = 0;
-    status = pv_rhino_get_intent(rhino_.get(), &intent, &num_slots, 
+    status = pv_rhino_get_intent(rhino, &intent, &num_slots, 
                                (const char***)&slots, 
                                (const char***)&values);
     
@@ -136,28 +190,33 @@ Command KeywordDetector::DetectCommand(const std::vector<int16_t>& buffer, bool
                 const_cast<const char**>(values));
             pv_rhino_reset(rhino);
         }
-    } cleanup{rhino_.get(), slots, values};
+    } cleanup{rhino, slots, values};
 
     if (status != PV_STATUS_SUCCESS) {
         ERROR_LOG("Failed to get intent from Rhino");
         throw std::runtime_error("Failed to get intent");
     }
 
-    // Process the intent
-    std::string intent_str(intent);
-    DEBUG_LOG("Detected intent: " + intent_str);
+    result.status = IntentStatus::UNDERSTOOD;
+    result.name = intent;
+    for (int32_t i = 0; i < num_slots; ++i) {
+        result.slots[slots[i]] = values[i];
+    }
 
-    if (intent_str == "changeState" && num_slots > 0) {
-        std::string value(values[0]);
-        if (value == "on") {
-            if (verbose) INFO_LOG("Command detected: TURN_ON");
-            return Command::TURN_ON;
-        }
-        if (value == "off") {
-            if (verbose) INFO_LOG("Command detected: TURN_OFF");
-            return Command::TURN_OFF;
+    if (verbose) {
+        std::string slot_str;
+        for (const auto& [slot, value] : result.slots) {
+            slot_str += " " + slot + "=" + value;
         }
+        INFO_LOG("Detected intent: " + result.context + "/" + result.name + slot_str);
     }
+    return result;
+}
+
+size_t KeywordDetector::KeywordCount() const {
+    return keyword_names_.size();
+}
 
-    return Command::NO_COMMAND;
-}
\ No newline at end of file
+const std::string& KeywordDetector::KeywordName(size_t keyword_index) const {
+    return keyword_names_.at(keyword_index);
+}
@@ -0,0 +1,67 @@
+#include "voice_activity_detector.h"
+#include "audio_dsp.h"
+#include <algorithm>
+#include <cmath>
+
+VoiceActivityDetector::VoiceActivityDetector(size_t hangover_frames, float threshold_ratio, float min_rms)
+    : hangover_frames_(hangover_frames),
+      threshold_ratio_(threshold_ratio),
+      min_rms_(min_rms) {
+}
+
+bool VoiceActivityDetector::Process(const int16_t* samples, size_t count) {
+    if (count == 0) {
+        return IsActive();
+    }
+
+    // Measure around the frame mean, the microphone has a DC offset
+    const int32_t offset = audio_dsp::Mean(samples, count);
+    int64_t energy = 0;
+    size_t crossings = 0;
+    bool previous_positive = samples[0] >= offset;
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t sample = samples[i] - offset;
+        energy += static_cast<int64_t>(sample) * sample;
+        const bool positive = sample >= 0;
+        crossings += positive != previous_positive;
+        previous_positive = positive;
+    }
+    const float rms = std::sqrt(static_cast<float>(energy) / count);
+    const float zcr = static_cast<float>(crossings) / count;
+    last_rms_ = rms;
+
+    if (noise_floor_ <= 0.0f || rms < noise_floor_) {
+        noise_floor_ = std::max(rms, 1.0f);
+    } else {
+        noise_floor_ *= NOISE_FLOOR_RISE;
+    }
+
+    const float threshold = std::max(min_rms_, noise_floor_ * threshold_ratio_);
+    const bool speech = rms > threshold ||
+        (rms > std::max(min_rms_, threshold / 2) && zcr > UNVOICED_ZCR);
+
+    if (speech) {
+        hangover_ = hangover_frames_ + 1;
+    } else if (hangover_ > 0) {
+        --hangover_;
+    }
+    return IsActive();
+}
+
+bool VoiceActivityDetector::IsActive() const {
+    return hangover_ > 0;
+}
+
+void VoiceActivityDetector::Reset() {
+    noise_floor_ = 0.0f;
+    last_rms_ = 0.0f;
+    hangover_ = 0;
+}
+
+float VoiceActivityDetector::NoiseFloor() const {
+    return noise_floor_;
+}
+
+float VoiceActivityDetector::LastRms() const {
+    return last_rms_;
+}
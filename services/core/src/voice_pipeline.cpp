@@ -0,0 +1,116 @@
+#include "voice_pipeline.h"
+#include "env.h"
+#include "log.h"
+
+namespace {
+
+// Frames of 32ms
+size_t MsToFrames(size_t ms) {
+    return (ms + 31) / 32;
+}
+
+}
+
+VoicePipelineConfig VoicePipelineConfig::FromEnv() {
+    VoicePipelineConfig config;
+    unsigned int hangover_ms = 320;
+    unsigned int preroll_ms = 320;
+    GetEnvVar("VAD_ENABLED", config.vad_enabled);
+    GetEnvVar("VAD_HANGOVER_MS", hangover_ms);
+    GetEnvVar("VAD_PREROLL_MS", preroll_ms);
+    config.vad_hangover_frames = MsToFrames(hangover_ms);
+    config.preroll_frames = MsToFrames(preroll_ms);
+    return config;
+}
+
+VoicePipeline::VoicePipeline(KeywordDetector& detector, const VoicePipelineConfig& config)
+    : detector_(detector),
+      vad_enabled_(config.vad_enabled),
+      vad_(config.vad_hangover_frames),
+      preroll_(config.preroll_frames),
+      preroll_frames_(config.preroll_frames) {
+}
+
+VoiceEvent VoicePipeline::ProcessFrame(int16_t* frame) {
+    VoiceEvent event;
+
+    if (active_keyword_ >= 0) {
+        // Command audio bypasses the VAD, Rhino needs the trailing silence to endpoint
+        if (FeedCommand(active_keyword_, frame, event.intent)) {
+            event.type = VoiceEventType::INTENT;
+            event.keyword = active_keyword_;
+            active_keyword_ = -1;
+        }
+        return event;
+    }
+
+    int32_t keyword = DetectWakeWord(frame, event);
+    if (keyword >= 0) {
+        if (!event.has_intent) {
+            active_keyword_ = keyword;
+        }
+        event.type = VoiceEventType::WAKE_WORD;
+        event.keyword = keyword;
+    }
+    return event;
+}
+
+int32_t VoicePipeline::DetectWakeWord(int16_t* frame, VoiceEvent& event) {
+    const size_t samples = AudioFrameRing::FRAME_SAMPLES;
+    if (vad_enabled_) {
+        if (!vad_.Process(frame, samples)) {
+            // Keep the most recent silent frames, the VAD may trigger a little late
+            if (preroll_frames_ > 0) {
+                while (preroll_.Size() >= preroll_frames_) {
+                    preroll_.AcquireRead();
+                    preroll_.ReleaseRead();
+                }
+                preroll_.Push(frame);
+            }
+            skipped_frames_++;
+            return -1;
+        }
+
+        // Speech onset: feed the pre-roll first so Porcupine hears the whole keyword
+        while (int16_t* pre = preroll_.AcquireRead()) {
+            int32_t keyword = detector_.DetectWakeWord(pre, samples, true);
+            preroll_.ReleaseRead();
+            processed_frames_++;
+            if (keyword >= 0) {
+                // The rest of the pre-roll and this frame are the start of the command
+                bool done = false;
+                while (int16_t* command = preroll_.AcquireRead()) {
+                    if (!done) {
+                        done = FeedCommand(keyword, command, event.intent);
+                    }
+                    preroll_.ReleaseRead();
+                }
+                if (!done) {
+                    done = FeedCommand(keyword, frame, event.intent);
+                }
+                event.has_intent = done;
+                return keyword;
+            }
+        }
+    }
+
+    processed_frames_++;
+    return detector_.DetectWakeWord(frame, samples, true);
+}
+
+bool VoicePipeline::FeedCommand(int32_t keyword, const int16_t* frame, Intent& intent) {
+    intent = detector_.DetectCommand(keyword, frame, AudioFrameRing::FRAME_SAMPLES, true);
+    return intent.status != IntentStatus::PROCESSING;
+}
+
+bool VoicePipeline::ListeningForCommand() const {
+    return active_keyword_ >= 0;
+}
+
+uint64_t VoicePipeline::SkippedFrames() const {
+    return skipped_frames_.load();
+}
+
+uint64_t VoicePipeline::ProcessedFrames() const {
+    return processed_frames_.load();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <functional>
 #include <mqtt/async_client.h>
@@ -15,6 +16,8 @@ public:
 
     // Core messaging methods
     virtual void Publish(const std::string& topic, const nlohmann::json& payload) = 0;
+    // Raw bytes, e.g. an encoded image, without JSON wrapping
+    virtual void PublishBinary(const std::string& topic, const void* data, size_t size) = 0;
     virtual void Subscribe(const std::string& topic) = 0;
 
     // Callback methods
@@ -69,6 +69,17 @@ void PahoMqttClient::Publish(const std::string& topic, const nlohmann::json& pay
     }
 }
 
+void PahoMqttClient::PublishBinary(const std::string& topic, const void* data, size_t size) {
+    try {
+        mqtt::message_ptr pubmsg = mqtt::message::create(topic, data, size);
+        pubmsg->set_qos(1);
+        mqtt_client_.publish(pubmsg);
+    } catch (const mqtt::exception& exc) {
+        std::string error_msg = "Failed to publish binary message: " + std::string(exc.what());
+        ERROR_LOG(error_msg.c_str());
+    }
+}
+
 void PahoMqttClient::Subscribe(const std::string& topic) {
     mqtt_client_.subscribe(topic, 1);
     INFO_LOG("Subscribed to topic: " + topic);
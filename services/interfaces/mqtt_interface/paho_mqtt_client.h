@@ -27,6 +27,7 @@ public:
     void Connect() override;
     void Disconnect() override;
     void Publish(const std::string& topic, const nlohmann::json& payload) override;
+    void PublishBinary(const std::string& topic, const void* data, size_t size) override;
     void Subscribe(const std::string& topic) override;
     void SetMessageCallback(mqtt::async_client::message_handler callback) override;
 };
\ No newline at end of file
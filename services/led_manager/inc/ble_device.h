@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <optional>
 #include <simpleble/SimpleBLE.h>
 #include <atomic>
 
@@ -12,6 +15,27 @@ struct BLEDeviceConfig {
     SimpleBLE::BluetoothUUID char_uuid_;
 };
 
+// What a bulb shows. The color is kept while the bulb is off so turning it back
+// on restores it.
+struct LightState {
+    bool on = false;
+    uint8_t r = 0;
+    uint8_t g = 255;
+    uint8_t b = 255;
+    // Percent
+    uint8_t brightness = 100;
+
+    bool SameColor(const LightState& other) const {
+        return r == other.r && g == other.g && b == other.b;
+    }
+    bool operator==(const LightState& other) const {
+        return on == other.on && SameColor(other) && brightness == other.brightness;
+    }
+    bool operator!=(const LightState& other) const {
+        return !(*this == other);
+    }
+};
+
 class BLEDevice {
 private:
     std::unique_ptr<SimpleBLE::Peripheral> peripheral_;
@@ -24,13 +48,18 @@ public:
            SimpleBLE::BluetoothUUID serv_uuid, SimpleBLE::BluetoothUUID char_uuid);
     ~BLEDevice();
 
-    void Connect();
+    // All operations return false on failure instead of throwing. Writes fail fast
+    // on a disconnected device, reconnecting is left to the connection manager.
+    bool Connect();
     bool IsConnected();
     void Disconnect();
     
-    void TurnOn();
-    void TurnOff();
-    void SetColor(uint8_t r, uint8_t g, uint8_t b);
+    bool PowerOn();
+    bool SetColor(uint8_t r, uint8_t g, uint8_t b);
+    bool SetBrightness(uint8_t percent);
+    // Move the bulb from current to target with the fewest writes, writing
+    // everything when current is unknown. writes counts the packets sent.
+    bool ApplyState(const std::optional<LightState>& current, const LightState& target, size_t& writes);
     std::string GetAddress();
 
     BLEDevice(const BLEDevice&) = delete;
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+#include "latency_histogram.h"
+
+enum class CommandPriority {
+    // Someone is waiting on it, e.g. a voice command
+    INTERACTIVE,
+    // State sync that can wait behind interactive commands
+    BACKGROUND
+};
+
+// The payload's "priority" field, "background" or anything else for interactive
+CommandPriority ParseCommandPriority(const nlohmann::json& payload);
+
+// Commands that overwrite the same fields on every device share a key ("color"
+// for set_color, "power" for turn_on/turn_off), so a newer one makes a queued
+// one pointless. Empty for commands that never supersede each other.
+std::string CoalesceKey(const nlohmann::json& payload);
+
+struct QueuedCommand {
+    nlohmann::json payload;
+    CommandPriority priority = CommandPriority::INTERACTIVE;
+    std::chrono::steady_clock::time_point enqueued;
+    std::string coalesce_key;
+};
+
+// Bounded two-level command queue. Interactive commands are always taken first.
+// When full the oldest background command is evicted, and when there is none an
+// interactive command evicts the oldest interactive one while a background
+// command is rejected. Stale commands go, the newest intent is kept.
+//
+// A command with a coalesce key replaces a queued one of the same priority and
+// key, so a slider burst arriving while a sync runs ends up as one write of the
+// latest value. The replacement goes to the back to keep its order relative to
+// the commands queued in between.
+class CommandQueue {
+public:
+    explicit CommandQueue(size_t capacity);
+
+    // False if the command itself was dropped
+    bool Push(nlohmann::json payload, CommandPriority priority, std::string coalesce_key = "");
+    // Wait up to timeout for a command
+    std::optional<QueuedCommand> Pop(std::chrono::milliseconds timeout);
+    // Wake any waiting Pop
+    void Close();
+
+    size_t Depth() const;
+    // {"depth", "capacity", "enqueued", "coalesced", "dropped": {"interactive", "background"},
+    //  "wait": {"interactive": histogram, "background": histogram}}
+    nlohmann::json Metrics() const;
+
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<QueuedCommand> interactive_;
+    std::deque<QueuedCommand> background_;
+    bool closed_ = false;
+
+    uint64_t enqueued_ = 0;
+    uint64_t coalesced_ = 0;
+    uint64_t dropped_interactive_ = 0;
+    uint64_t dropped_background_ = 0;
+    // Time from Push to Pop
+    LatencyHistogram interactive_wait_;
+    LatencyHistogram background_wait_;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs one device's BLE operations on its own thread. Operations on the same
+// device stay serialized while different devices proceed in parallel.
+class DeviceWorker {
+public:
+    explicit DeviceWorker(std::string name);
+    ~DeviceWorker();
+
+    // Queue an operation, the future yields its result. Operations still queued
+    // when the worker stops are dropped and their futures report broken_promise.
+    std::future<bool> Submit(std::function<bool()> operation);
+
+    size_t Pending() const;
+    void Stop();
+
+    DeviceWorker(const DeviceWorker&) = delete;
+    DeviceWorker& operator=(const DeviceWorker&) = delete;
+
+private:
+    std::string name_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::packaged_task<bool()>> tasks_;
+    bool stopping_ = false;
+    std::thread thread_;
+
+    void Run();
+};
@@ -1,19 +1,26 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <memory>
 #include <string>
 #include <mutex>
-#include <queue>
+#include <condition_variable>
+#include <thread>
 #include <atomic>
 #include <unordered_map>
 #include <functional>
+#include <future>
 #include <simpleble/SimpleBLE.h>
 #include <nlohmann/json.hpp>
 
 #include "ble_device.h"
+#include "command_queue.h"
+#include "device_worker.h"
+#include "latency_histogram.h"
 #include "paho_mqtt_client.h"
 #include "service_interface.h"
+#include "trace_context.h"
 
 using json = nlohmann::json;
 
@@ -40,10 +47,26 @@ private:
     // Constants
     static constexpr const char* COMMAND_TOPIC = "home/services/led_manager/command";
     static constexpr const char* STATUS_TOPIC = "home/services/led_manager/status";
+    static constexpr const char* METRICS_TOPIC = "home/services/led_manager/metrics";
     static constexpr const char* LED_STATE_TOPIC_PREFIX = "home/devices/leds/";
 
+    // Slowest a single bulb may take before a group command reports it as timed out
+    static constexpr std::chrono::milliseconds DEVICE_COMMAND_TIMEOUT{5000};
+    // Reconnect and rediscovery backoff
+    static constexpr std::chrono::milliseconds INITIAL_BACKOFF{1000};
+    static constexpr std::chrono::milliseconds MAX_BACKOFF{60000};
+    static constexpr std::chrono::milliseconds CONNECT_TIMEOUT{10000};
+    static constexpr int SCAN_DURATION_MS = 5000;
+    // Fastest a single bulb is written, commands arriving faster are coalesced
+    static constexpr std::chrono::milliseconds MIN_WRITE_INTERVAL{100};
+    static constexpr size_t COMMAND_QUEUE_CAPACITY = 64;
+
     // Types
-    using CommandHandler = std::function<void(const json&)>;
+    // Returns the FanOut report, or null when the command was rejected before any write
+    using CommandHandler = std::function<json(const json&)>;
+    using StateUpdate = std::function<void(LightState&)>;
+    // Address to the update for that device
+    using StateUpdates = std::unordered_map<std::string, StateUpdate>;
 
     // State
     std::atomic<bool> running_{true};
@@ -56,34 +79,100 @@ private:
 
     // Device management
     std::mutex devices_mutex_;
-    std::vector<std::unique_ptr<BLEDevice>> devices_;
+    std::vector<std::shared_ptr<BLEDevice>> devices_;
+    // One worker per configured address, so bulbs are driven in parallel
+    std::unordered_map<std::string, std::unique_ptr<DeviceWorker>> workers_;
     void InitAdapter();
-    void FindAndInitDevices(std::vector<BLEDeviceConfig>& dc);
-    void FindAndInitDevice(BLEDeviceConfig& config);
-    void ReconnectDevices();
-    void ReinitDevices();
-
-    // Command handling
-    std::mutex cmd_queue_mutex_;
-    std::condition_variable cmd_queue_cv_;
-    std::queue<nlohmann::json> cmd_queue_;
-    void HandleCommand(const nlohmann::json& command);
+    std::shared_ptr<BLEDevice> FindDevice(const std::string& address);
+
+    // Connection manager. Discovery and reconnects run on their own thread with
+    // per-device exponential backoff so commands never wait behind them.
+    struct DeviceHealth {
+        bool connected = false;
+        uint64_t connect_attempts = 0;
+        uint64_t connect_failures = 0;
+        uint64_t disconnects = 0;
+        uint32_t consecutive_failures = 0;
+        std::chrono::milliseconds backoff{0};
+        std::chrono::steady_clock::time_point next_attempt;
+        std::chrono::steady_clock::time_point connected_since;
+    };
+    std::thread connection_thread_;
+    std::mutex health_mutex_;
+    std::condition_variable connection_cv_;
+    std::unordered_map<std::string, DeviceHealth> health_;
+    void ConnectionLoop();
+    // One shared scan for every missing device whose backoff has expired
+    void DiscoverDevices(const std::vector<BLEDeviceConfig>& missing);
+    void ReconnectDevice(const std::shared_ptr<BLEDevice>& device);
+    void RecordConnectResult(const std::string& address, bool connected);
+    // Check a device that just failed a write now instead of on the next tick.
+    // Missing devices and ones already on a backoff are left alone.
+    void RequestReconnect(const std::string& address);
+    json DeviceHealthReport();
+
+    // Desired state model. Commands only update the target state, a sync on the
+    // device's worker writes whatever differs from the last acknowledged state.
+    // Updates arriving while a sync is queued collapse into it. Commands run one
+    // at a time, so bursts are collapsed earlier, in the command queue.
+    struct DeviceState {
+        LightState desired;
+        // Unknown until the first successful write and again after a reconnect
+        std::optional<LightState> acknowledged;
+        uint64_t generation = 0;
+        bool sync_queued = false;
+        std::chrono::steady_clock::time_point last_write;
+        // Resolved once a sync covering their generation finishes
+        std::vector<std::pair<uint64_t, std::promise<bool>>> waiters;
+        uint64_t writes = 0;
+        uint64_t skipped = 0;
+        uint64_t coalesced = 0;
+    };
+    std::mutex state_mutex_;
+    std::unordered_map<std::string, DeviceState> states_;
+    std::future<bool> RequestState(const std::string& address, const StateUpdate& update);
+    bool SyncDevice(const std::string& address);
+    // Forget the acknowledged state and write the desired one again
+    void ResyncDevice(const std::string& address);
+    json WriteStats();
+
+    // Command handling. The MQTT callback only enqueues, Run executes.
+    CommandQueue cmd_queue_{COMMAND_QUEUE_CAPACITY};
+    void HandleCommand(const nlohmann::json& command, TraceContext& trace);
     void IncomingMessage(const std::string& topic, const std::string& payload);
 
+    // Latency of traced commands, exported on METRICS_TOPIC
+    LatencyHistogram delivery_latency_;
+    LatencyHistogram ble_latency_;
+    LatencyHistogram end_to_end_latency_;
+    void RecordTrace(const TraceContext& trace);
+    void PublishMetrics();
+
     // LED control operations
-    void TurnOnAll();
-    void TurnOffAll();
-    void SetColor(int r, int g, int b);
+    json TurnOnAll();
+    json TurnOffAll();
+    json SetColor(int r, int g, int b);
+    // Per-device target states in one pass, see the "scene" handler
+    json ApplyScene(const std::string& command, const json& params);
+    // Apply each update to its device's desired state, wait up to DEVICE_COMMAND_TIMEOUT
+    // for the devices to sync in parallel and publish one aggregated report
+    json FanOut(const std::string& command, const StateUpdates& updates);
+    // The same update for every configured device
+    json FanOut(const std::string& command, const StateUpdate& update);
 
     // Command handlers map
     const std::unordered_map<std::string, CommandHandler> command_handlers_ = {
-        {"turn_on",   [this](const nlohmann::json&) { TurnOnAll(); }},
-        {"turn_off",  [this](const nlohmann::json&) { TurnOffAll(); }},
+        {"turn_on",   [this](const nlohmann::json&) { return TurnOnAll(); }},
+        {"turn_off",  [this](const nlohmann::json&) { return TurnOffAll(); }},
         {"set_color", [this](const nlohmann::json& payload) { 
             int r = payload["params"]["r"];
             int g = payload["params"]["g"];
             int b = payload["params"]["b"];
-            SetColor(r, g, b);
-        }}
+            return SetColor(r, g, b);
+        }},
+        // {"command": "scene", "params": {"devices": {"<address>": {"on": true, "r": 255,
+        //  "g": 120, "b": 0, "brightness": 60}}}}, fields left out keep their current value
+        {"scene",     [this](const nlohmann::json& payload) { return ApplyScene("scene", payload["params"]); }},
+        {"batch",     [this](const nlohmann::json& payload) { return ApplyScene("batch", payload["params"]); }}
     };
 };
\ No newline at end of file
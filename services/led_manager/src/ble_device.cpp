@@ -1,5 +1,6 @@
 #include "ble_device.h"
 #include "log.h"
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include "led_manager.h"
@@ -27,18 +28,18 @@ BLEDevice::~BLEDevice() {
     Disconnect();
 }
 
-const int MAX_ATTEMPTS = 3;
-const int RETRY_DELAY_MS = 1000;
-void BLEDevice::Connect() {
+bool BLEDevice::Connect() {
     try {
         if (!peripheral_->is_connected()) {
             peripheral_->connect();
         }
+        return true;
     } catch (const SimpleBLE::Exception::OperationFailed& e) {
         ERROR_LOG("Failed to connect to device " + address_ + ": " + e.what());
     } catch (const std::exception& e) {
         ERROR_LOG("Unexpected error while connecting to device " + address_ + ": " + e.what());
     }
+    return false;
 }
 
 void BLEDevice::Disconnect() {
@@ -69,39 +70,94 @@ bool BLEDevice::IsConnected() {
     }
 }
 
-void BLEDevice::TurnOn() {
+bool BLEDevice::PowerOn() {
     try {
-        Connect();
+        if (!peripheral_->is_connected()) {
+            WARN_LOG("Cannot turn on disconnected device: " + address_);
+            return false;
+        }
         peripheral_->write_command(serv_uuid_, char_uuid_, SimpleBLE::ByteArray::fromHex("7e0704ff00010201ef"));
-        SetColor(static_cast<uint8_t>(0), static_cast<uint8_t>(255), static_cast<uint8_t>(255));
         INFO_LOG("Turned on device: " + address_);
+        return true;
     } catch (const SimpleBLE::Exception::OperationFailed& e) {
         ERROR_LOG("Failed to turn on device " + address_ + ": " + e.what());
     } catch (const std::exception& e) {
         ERROR_LOG("Unexpected error while turning on device " + address_ + ": " + e.what());
     }
+    return false;
 }
 
-void BLEDevice::TurnOff() {
-    DEBUG_LOG("Turning off device: " + address_);
-    SetColor(static_cast<uint8_t>(0), static_cast<uint8_t>(0), static_cast<uint8_t>(0));
+bool BLEDevice::ApplyState(const std::optional<LightState>& current, const LightState& target, size_t& writes) {
+    writes = 0;
+    if (!target.on) {
+        // The bulbs are switched off by going dark
+        if (current && !current->on) {
+            return true;
+        }
+        DEBUG_LOG("Turning off device: " + address_);
+        writes++;
+        return SetColor(0, 0, 0);
+    }
+
+    bool was_on = current && current->on;
+    if (!was_on) {
+        writes++;
+        if (!PowerOn()) {
+            return false;
+        }
+    }
+    if (!was_on || current->brightness != target.brightness) {
+        writes++;
+        if (!SetBrightness(target.brightness)) {
+            return false;
+        }
+    }
+    if (was_on && current->SameColor(target)) {
+        return true;
+    }
+    writes++;
+    return SetColor(target.r, target.g, target.b);
 }
 
-void BLEDevice::SetColor(uint8_t r, uint8_t g, uint8_t b) {
+bool BLEDevice::SetColor(uint8_t r, uint8_t g, uint8_t b) {
     char hex[21];
     snprintf(hex, sizeof(hex), "7e070503%02x%02x%02x10ef", r, g, b);
     try {
-        Connect();
+        if (!peripheral_->is_connected()) {
+            WARN_LOG("Cannot set color on disconnected device: " + address_);
+            return false;
+        }
         peripheral_->write_command(serv_uuid_, char_uuid_, SimpleBLE::ByteArray::fromHex(hex));
         INFO_LOG("Set color (R:" + std::to_string(r) + 
                  ", G:" + std::to_string(g) + 
                  ", B:" + std::to_string(b) + 
                  ") for device: " + address_);
+        return true;
     } catch (const SimpleBLE::Exception::OperationFailed& e) {
         ERROR_LOG("Failed to set color for " + address_ + ": " + e.what());
     } catch (const std::exception& e) {
         ERROR_LOG("Failed to set color for " + address_ + ": " + e.what());
     }
+    return false;
+}
+
+bool BLEDevice::SetBrightness(uint8_t percent) {
+    char hex[19];
+    snprintf(hex, sizeof(hex), "7e0401%02x01ffff00ef", std::min<uint8_t>(percent, 100));
+    try {
+        if (!peripheral_->is_connected()) {
+            WARN_LOG("Cannot set brightness on disconnected device: " + address_);
+            return false;
+        }
+        peripheral_->write_command(serv_uuid_, char_uuid_, SimpleBLE::ByteArray::fromHex(hex));
+        INFO_LOG("Set brightness " + std::to_string(percent) + "% for device: " + address_);
+        return true;
+    } catch (const SimpleBLE::Exception::OperationFailed& e) {
+        ERROR_LOG("Failed to set brightness for " + address_ + ": " + e.what());
+    } catch (const std::exception& e) {
+        ERROR_LOG("Failed to set brightness for " + address_ + ": " + e.what());
+    }
+    return false;
 }
 
 std::string BLEDevice::GetAddress() {
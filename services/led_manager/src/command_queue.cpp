@@ -0,0 +1,114 @@
+#include "command_queue.h"
+#include "log.h"
+#include <algorithm>
+
+CommandPriority ParseCommandPriority(const nlohmann::json& payload) {
+    if (payload.contains("priority") && payload["priority"] == "background") {
+        return CommandPriority::BACKGROUND;
+    }
+    return CommandPriority::INTERACTIVE;
+}
+
+std::string CoalesceKey(const nlohmann::json& payload) {
+    const std::string command = payload.value("command", "");
+    if (command == "set_color") {
+        return "color";
+    }
+    if (command == "turn_on" || command == "turn_off") {
+        return "power";
+    }
+    return "";
+}
+
+CommandQueue::CommandQueue(size_t capacity)
+    : capacity_(capacity) {
+}
+
+bool CommandQueue::Push(nlohmann::json payload, CommandPriority priority, std::string coalesce_key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& target = priority == CommandPriority::INTERACTIVE ? interactive_ : background_;
+        if (!coalesce_key.empty()) {
+            auto superseded = std::find_if(target.begin(), target.end(), [&](const QueuedCommand& queued) {
+                return queued.coalesce_key == coalesce_key;
+            });
+            if (superseded != target.end()) {
+                target.erase(superseded);
+                coalesced_++;
+            }
+        }
+
+        if (interactive_.size() + background_.size() >= capacity_) {
+            if (!background_.empty()) {
+                background_.pop_front();
+                dropped_background_++;
+                WARN_LOG("Command queue full, dropped oldest background command");
+            } else if (priority == CommandPriority::INTERACTIVE) {
+                interactive_.pop_front();
+                dropped_interactive_++;
+                WARN_LOG("Command queue full, dropped oldest interactive command");
+            } else {
+                dropped_background_++;
+                WARN_LOG("Command queue full, rejected background command");
+                return false;
+            }
+        }
+
+        target.push_back({std::move(payload), priority, std::chrono::steady_clock::now(), std::move(coalesce_key)});
+        enqueued_++;
+    }
+    cv_.notify_one();
+    return true;
+}
+
+std::optional<QueuedCommand> CommandQueue::Pop(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, timeout, [this] {
+        return closed_ || !interactive_.empty() || !background_.empty();
+    });
+    if (closed_) {
+        return std::nullopt;
+    }
+
+    auto& source = !interactive_.empty() ? interactive_ : background_;
+    if (source.empty()) {
+        return std::nullopt;
+    }
+    QueuedCommand command = std::move(source.front());
+    source.pop_front();
+    lock.unlock();
+
+    double waited_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - command.enqueued).count();
+    if (command.priority == CommandPriority::INTERACTIVE) {
+        interactive_wait_.Record(waited_ms);
+    } else {
+        background_wait_.Record(waited_ms);
+    }
+    return command;
+}
+
+void CommandQueue::Close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    cv_.notify_all();
+}
+
+size_t CommandQueue::Depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interactive_.size() + background_.size();
+}
+
+nlohmann::json CommandQueue::Metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"depth", interactive_.size() + background_.size()},
+        {"capacity", capacity_},
+        {"enqueued", enqueued_},
+        {"coalesced", coalesced_},
+        {"dropped", {{"interactive", dropped_interactive_}, {"background", dropped_background_}}},
+        {"wait", {{"interactive", interactive_wait_.ToJson()}, {"background", background_wait_.ToJson()}}}
+    };
+}
@@ -0,0 +1,66 @@
+#include "device_worker.h"
+#include "log.h"
+
+DeviceWorker::DeviceWorker(std::string name)
+    : name_(std::move(name)) {
+    thread_ = std::thread(&DeviceWorker::Run, this);
+}
+
+DeviceWorker::~DeviceWorker() {
+    Stop();
+}
+
+std::future<bool> DeviceWorker::Submit(std::function<bool()> operation) {
+    std::packaged_task<bool()> task(std::move(operation));
+    std::future<bool> result = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            // Dropping the task breaks the promise
+            return result;
+        }
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return result;
+}
+
+size_t DeviceWorker::Pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size();
+}
+
+void DeviceWorker::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        tasks_.clear();
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+        DEBUG_LOG("Worker for device " + name_ + " stopped");
+    }
+}
+
+void DeviceWorker::Run() {
+    while (true) {
+        std::packaged_task<bool()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_) {
+                break;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            // packaged_task stores exceptions from the operation itself, this is only setup failure
+            ERROR_LOG("Error running operation for device " + name_ + ": " + e.what());
+        }
+    }
+}
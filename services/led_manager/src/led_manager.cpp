@@ -1,5 +1,6 @@
 #include "led_manager.h"
 #include "log.h"
+#include <algorithm>
 #include <fstream>
 
 using json = nlohmann::json;
@@ -9,6 +10,12 @@ LEDManager::LEDManager(const std::vector<BLEDeviceConfig>& configs, const std::s
     : PahoMqttClient(broker_address, client_id, ca_path, username, password),
       device_configs_(configs) {
 
+    for (const auto& config : device_configs_) {
+        workers_[config.address_] = std::make_unique<DeviceWorker>(config.address_);
+        health_[config.address_] = DeviceHealth();
+        states_[config.address_] = DeviceState();
+    }
+
     SetMessageCallback([this](mqtt::const_message_ptr msg) {
         this->IncomingMessage(msg->get_topic(), msg->to_string());
     });
@@ -29,59 +36,43 @@ void LEDManager::Initialize() {
 
 void LEDManager::Run() {
     InitAdapter();
-    FindAndInitDevices(device_configs_);
+    INFO_LOG("Starting connection manager thread");
+    connection_thread_ = std::thread(&LEDManager::ConnectionLoop, this);
     INFO_LOG("LEDManager running...");
 
     auto last_status_time = std::chrono::steady_clock::now();
-    auto last_reconnect_time = std::chrono::steady_clock::now();
-    auto last_reinit_time = std::chrono::steady_clock::now();
+    auto last_metrics_time = std::chrono::steady_clock::now();
     const auto status_interval = std::chrono::seconds(5);
-    const auto reconnect_interval = std::chrono::seconds(10);
-    const auto reinit_interval = std::chrono::seconds(60);
+    const auto metrics_interval = std::chrono::seconds(30);
 
     while (running_) {
-        // Reinitialize devices if they are not connected
-        auto now = std::chrono::steady_clock::now();
-        if (now - last_reinit_time >= reinit_interval) {
-            ReinitDevices();
-            last_reinit_time = now;
-        }
-
-        // Reconnect devices if they are disconnected
-        now = std::chrono::steady_clock::now();
-        if (now - last_reconnect_time >= reconnect_interval) {
-            ReconnectDevices();
-            last_reconnect_time = now;
-        }
-
         // Handle commands
-        json command;
-        {
-            std::unique_lock<std::mutex> lock(cmd_queue_mutex_);
-            cmd_queue_cv_.wait_for(lock, std::chrono::seconds(1),
-                [this] {return !cmd_queue_.empty() || !running_; });
-            
-            if (!running_) break;
-            if (!cmd_queue_.empty()) {
-                command = std::move(cmd_queue_.front());
-                cmd_queue_.pop();
-            }
-        }
-        if (!command.is_null()) {
-            HandleCommand(command);
+        auto command = cmd_queue_.Pop(std::chrono::seconds(1));
+        if (!running_) break;
+        if (command) {
+            TraceContext trace = TraceContext::FromJson(command->payload);
+            trace.Mark("dequeued");
+            HandleCommand(command->payload, trace);
         }
 
         // Publish heartbeat status
-        now = std::chrono::steady_clock::now();
+        auto now = std::chrono::steady_clock::now();
         if (now - last_status_time >= status_interval) {
             try {
                 nlohmann::json status_msg = {{"status", "online"}};
+                status_msg["devices"] = DeviceHealthReport();
+                status_msg["queue_depth"] = cmd_queue_.Depth();
                 Publish(STATUS_TOPIC, status_msg);
             } catch (const std::exception& e) {
                 ERROR_LOG("Exception in status update: " + std::string(e.what()));
             }
             last_status_time = now;
         }
+
+        if (now - last_metrics_time >= metrics_interval) {
+            PublishMetrics();
+            last_metrics_time = now;
+        }
     }
     INFO_LOG("LEDManager stopped");
 }
@@ -89,17 +80,40 @@ void LEDManager::Run() {
 void LEDManager::Stop() {
     INFO_LOG("Stopping LEDManager");
     running_ = false;
-    cmd_queue_cv_.notify_one();
+    cmd_queue_.Close();
+    connection_cv_.notify_one();
 
-    // Disconnect all devices
-    for (auto& device : devices_) {
-        device->Disconnect();
+    // Finish in-flight BLE operations before disconnecting, this also releases
+    // the connection manager if it is waiting on a connect
+    for (auto& [address, worker] : workers_) {
+        worker->Stop();
+    }
+    {
+        // Nothing will sync anymore, fail the outstanding requests so a command
+        // in flight on the worker thread doesn't hold up the join below
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        for (auto& [address, state] : states_) {
+            for (auto& [generation, waiter] : state.waiters) {
+                waiter.set_value(false);
+            }
+            state.waiters.clear();
+        }
+    }
+    if (connection_thread_.joinable()) {
+        connection_thread_.join();
     }
-    devices_.clear();
-    
     if (worker_thread_.joinable()) {
         worker_thread_.join();
     }
+
+    // Disconnect all devices
+    {
+        std::lock_guard<std::mutex> lock(devices_mutex_);
+        for (auto& device : devices_) {
+            device->Disconnect();
+        }
+        devices_.clear();
+    }
     
     try {
         nlohmann::json status_msg = {{"status", "offline"}};
@@ -122,80 +136,229 @@ void LEDManager::InitAdapter() {
     INFO_LOG("Bluetooth adapter initialized successfully");
 }
 
-void LEDManager::FindAndInitDevices(std::vector<BLEDeviceConfig>& dc) {
-    adapter_->scan_for(5000);
-    auto peripherals = adapter_->scan_get_results();
-    DEBUG_LOG("Found " + std::to_string(peripherals.size()) + " BLE devices");
+std::shared_ptr<BLEDevice> LEDManager::FindDevice(const std::string& address) {
+    std::lock_guard<std::mutex> lock(devices_mutex_);
+    for (auto& device : devices_) {
+        if (device->GetAddress() == address) {
+            return device;
+        }
+    }
+    return nullptr;
+}
 
-    for(const auto& config : dc) {
-        INFO_LOG("Scanning for device: " + config.address_);
-        bool found = false;
+void LEDManager::ConnectionLoop() {
+    INFO_LOG("Connection manager running...");
 
-        for (auto& peripheral : peripherals) {
-            if (peripheral.address() == config.address_) {
-                try {
-                    auto device = std::make_unique<BLEDevice>(
-                        std::make_unique<SimpleBLE::Peripheral>(std::move(peripheral)),
-                        config.address_,
-                        config.serv_uuid_,
-                        config.char_uuid_);
-                    std::lock_guard<std::mutex> lock(devices_mutex_);
-                    devices_.push_back(std::move(device));
-                    INFO_LOG("Successfully initialized device: " + config.address_);
-                    found = true;
-                    break;
-                } catch (const std::exception& e) {
-                    ERROR_LOG("Failed to initialize device " + config.address_ + ": " + e.what());
-                }
+    while (running_) {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<BLEDeviceConfig> missing;
+        std::vector<std::shared_ptr<BLEDevice>> disconnected;
+
+        for (const auto& config : device_configs_) {
+            auto device = FindDevice(config.address_);
+            bool connected = device && device->IsConnected();
+
+            std::lock_guard<std::mutex> lock(health_mutex_);
+            DeviceHealth& health = health_[config.address_];
+            if (health.connected && !connected) {
+                WARN_LOG("Device " + config.address_ + " disconnected");
+                health.disconnects++;
+                health.next_attempt = now;
+            }
+            health.connected = connected;
+            if (connected || now < health.next_attempt) {
+                continue;
+            }
+
+            if (device) {
+                disconnected.push_back(device);
+            } else {
+                missing.push_back(config);
             }
         }
-        if(!found) WARN_LOG("Device not found: " + config.address_);
+
+        for (auto& device : disconnected) {
+            if (!running_) break;
+            ReconnectDevice(device);
+        }
+
+        if (!missing.empty() && running_) {
+            DiscoverDevices(missing);
+        }
+
+        std::unique_lock<std::mutex> lock(health_mutex_);
+        connection_cv_.wait_for(lock, std::chrono::seconds(1), [this] { return !running_; });
     }
+
+    INFO_LOG("Connection manager stopped");
 }
 
-void LEDManager::FindAndInitDevice(BLEDeviceConfig& config) {
-    adapter_->scan_for(5000);
-    auto peripherals = adapter_->scan_get_results();
+void LEDManager::DiscoverDevices(const std::vector<BLEDeviceConfig>& missing) {
+    INFO_LOG("Scanning for " + std::to_string(missing.size()) + " missing devices");
+    std::vector<SimpleBLE::Peripheral> peripherals;
+    try {
+        adapter_->scan_for(SCAN_DURATION_MS);
+        peripherals = adapter_->scan_get_results();
+    } catch (const std::exception& e) {
+        ERROR_LOG("BLE scan failed: " + std::string(e.what()));
+    }
     DEBUG_LOG("Found " + std::to_string(peripherals.size()) + " BLE devices");
 
-    for (auto& peripheral : peripherals) {
-        if (peripheral.address() == config.address_) {
+    for (const auto& config : missing) {
+        bool found = false;
+        for (auto& peripheral : peripherals) {
+            if (peripheral.address() != config.address_) {
+                continue;
+            }
             try {
-                auto device = std::make_unique<BLEDevice>(
+                // The constructor connects
+                auto device = std::make_shared<BLEDevice>(
                     std::make_unique<SimpleBLE::Peripheral>(std::move(peripheral)),
                     config.address_,
                     config.serv_uuid_,
                     config.char_uuid_);
+                found = device->IsConnected();
                 std::lock_guard<std::mutex> lock(devices_mutex_);
                 devices_.push_back(std::move(device));
                 INFO_LOG("Successfully initialized device: " + config.address_);
-                return;
             } catch (const std::exception& e) {
                 ERROR_LOG("Failed to initialize device " + config.address_ + ": " + e.what());
             }
+            break;
+        }
+        if (!found) WARN_LOG("Device not found: " + config.address_);
+        RecordConnectResult(config.address_, found);
+        if (found) {
+            ResyncDevice(config.address_);
+        }
+    }
+}
+
+void LEDManager::ReconnectDevice(const std::shared_ptr<BLEDevice>& device) {
+    // Connect on the device's worker so it doesn't race a write to the same bulb
+    const std::string address = device->GetAddress();
+    bool connected = false;
+    auto future = workers_.at(address)->Submit([device] { return device->Connect() && device->IsConnected(); });
+    if (future.wait_for(CONNECT_TIMEOUT) == std::future_status::ready) {
+        try {
+            connected = future.get();
+        } catch (const std::exception&) {
+            // Worker stopped
+        }
+    } else {
+        WARN_LOG("Connecting to device " + address + " timed out");
+    }
+    RecordConnectResult(address, connected);
+    if (connected) {
+        ResyncDevice(address);
+    }
+}
+
+void LEDManager::RecordConnectResult(const std::string& address, bool connected) {
+    std::lock_guard<std::mutex> lock(health_mutex_);
+    DeviceHealth& health = health_[address];
+    const auto now = std::chrono::steady_clock::now();
+    health.connect_attempts++;
+
+    if (connected) {
+        if (health.consecutive_failures > 0) {
+            INFO_LOG("Device " + address + " reconnected after " +
+                     std::to_string(health.consecutive_failures) + " failed attempts");
+        }
+        health.connected = true;
+        health.connected_since = now;
+        health.consecutive_failures = 0;
+        health.backoff = std::chrono::milliseconds(0);
+        return;
+    }
+
+    health.connected = false;
+    health.connect_failures++;
+    health.consecutive_failures++;
+    health.backoff = health.backoff.count() == 0 ? INITIAL_BACKOFF : std::min(health.backoff * 2, MAX_BACKOFF);
+    health.next_attempt = now + health.backoff;
+    DEBUG_LOG("Device " + address + " retry in " + std::to_string(health.backoff.count()) + "ms");
+}
+
+void LEDManager::RequestReconnect(const std::string& address) {
+    // Missing devices need a scan, they stay on their backoff
+    if (!FindDevice(address)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(health_mutex_);
+        auto it = health_.find(address);
+        // Only a fresh drop skips ahead, a device already known to be down keeps its backoff
+        if (it == health_.end() || !it->second.connected) {
+            return;
+        }
+        it->second.next_attempt = std::chrono::steady_clock::now();
+    }
+    connection_cv_.notify_one();
+}
+
+json LEDManager::DeviceHealthReport() {
+    std::lock_guard<std::mutex> lock(health_mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    json report = json::array();
+    for (const auto& config : device_configs_) {
+        const DeviceHealth& health = health_[config.address_];
+        json entry = {
+            {"address", config.address_},
+            {"connected", health.connected},
+            {"connect_attempts", health.connect_attempts},
+            {"connect_failures", health.connect_failures},
+            {"disconnects", health.disconnects},
+            {"consecutive_failures", health.consecutive_failures}
+        };
+        if (health.connected) {
+            entry["connected_s"] = std::chrono::duration_cast<std::chrono::seconds>(now - health.connected_since).count();
+        } else {
+            entry["retry_in_ms"] = std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::milliseconds>(health.next_attempt - now).count());
         }
+        report.push_back(entry);
     }
-    WARN_LOG("Device not found: " + config.address_);
+    return report;
 }
 
 void LEDManager::IncomingMessage(const std::string& topic, const std::string& payload) {
     INFO_LOG("Received message on topic: " + topic + ", payload: " + payload);
     if (topic.find("home/services/led_manager/command") == 0) {
-        HandleCommand(json::parse(payload));
+        try {
+            json command = json::parse(payload);
+            CommandPriority priority = ParseCommandPriority(command);
+            // Stamp the trace before queueing so the queue wait is part of it
+            TraceContext trace = TraceContext::FromJson(command);
+            trace.Mark("received");
+            if (trace.Active()) {
+                command["trace"] = trace.ToJson();
+            }
+            std::string coalesce_key = CoalesceKey(command);
+            cmd_queue_.Push(std::move(command), priority, std::move(coalesce_key));
+        } catch (const std::exception& e) {
+            ERROR_LOG("Error queueing command: " + std::string(e.what()));
+        }
     }
 }
 
 /*
  * HandleCommand and Command Handlers 
  */
-void LEDManager::HandleCommand(const json& payload) {
+void LEDManager::HandleCommand(const json& payload, TraceContext& trace) {
     try {
         std::string action = payload["command"];
         DEBUG_LOG("Handling command: " + action);
         
         auto handler = command_handlers_.find(action);
         if (handler != command_handlers_.end()) {
-            handler->second(payload);
+            json report = handler->second(payload);
+            // Only a command every device acknowledged counts towards the write latency,
+            // timeouts and failures would skew it
+            bool written = report.is_object() && report.value("total", 0) > 0 &&
+                           report.value("succeeded", 0) == report.value("total", 0);
+            trace.Mark(written ? "ble_written" : "ble_failed");
+            RecordTrace(trace);
         } else {
             WARN_LOG("Unknown command received: " + action);
         }
@@ -204,45 +367,274 @@ void LEDManager::HandleCommand(const json& payload) {
     }
 }
 
-void LEDManager::ReconnectDevices() {
-    for (auto& device : devices_) {
-        device->Connect();
+void LEDManager::RecordTrace(const TraceContext& trace) {
+    if (!trace.Active()) {
+        return;
     }
+
+    double delivery = trace.ElapsedMs("publish", "received");
+    double ble = trace.ElapsedMs("dequeued", "ble_written");
+    double end_to_end = trace.ElapsedMs("wake_word", "ble_written");
+    if (delivery >= 0) delivery_latency_.Record(delivery);
+    if (ble >= 0) ble_latency_.Record(ble);
+    if (end_to_end >= 0) end_to_end_latency_.Record(end_to_end);
+
+    INFO_LOG("Trace " + trace.Id() + ": " + trace.Summary());
 }
 
-void LEDManager::ReinitDevices() {
-    for (auto& config : device_configs_) {
-        if (std::find_if(devices_.begin(), devices_.end(), 
-                         [config](const std::unique_ptr<BLEDevice>& d) {
-                             return d->GetAddress() == config.address_;
-                         }) == devices_.end()) {
-            FindAndInitDevice(config);
-        }
+void LEDManager::PublishMetrics() {
+    try {
+        nlohmann::json metrics_msg = {
+            {"mqtt_delivery", delivery_latency_.ToJson()},
+            {"ble_write", ble_latency_.ToJson()},
+            {"wake_word_to_ble_write", end_to_end_latency_.ToJson()},
+            {"writes", WriteStats()},
+            {"command_queue", cmd_queue_.Metrics()}
+        };
+        Publish(METRICS_TOPIC, metrics_msg);
+    } catch (const std::exception& e) {
+        ERROR_LOG("Exception in metrics update: " + std::string(e.what()));
     }
 }
 
-void LEDManager::TurnOnAll() {
+json LEDManager::TurnOnAll() {
     INFO_LOG("Turning on all devices");
-    std::lock_guard<std::mutex> lock(devices_mutex_);
-    for (auto& device : devices_) {
-        device->TurnOn();
-    }
+    return FanOut("turn_on", [](LightState& state) { state.on = true; });
 }
 
-void LEDManager::TurnOffAll() {
+json LEDManager::TurnOffAll() {
     INFO_LOG("Turning off all devices");
-    std::lock_guard<std::mutex> lock(devices_mutex_);
-    for (auto& device : devices_) {
-        device->TurnOff();
-    }
+    return FanOut("turn_off", [](LightState& state) { state.on = false; });
 }
 
-void LEDManager::SetColor(int r, int g, int b) {
+json LEDManager::SetColor(int r, int g, int b) {
+    // Out of range channels saturate instead of wrapping around
+    r = std::clamp(r, 0, 255);
+    g = std::clamp(g, 0, 255);
+    b = std::clamp(b, 0, 255);
     INFO_LOG("Setting color for all devices (R:" + std::to_string(r) + 
              ", G:" + std::to_string(g) + 
              ", B:" + std::to_string(b) + ")");
-    std::lock_guard<std::mutex> lock(devices_mutex_);
-    for (auto& device : devices_) {
-        device->SetColor(r, g, b);
+    return FanOut("set_color", [r, g, b](LightState& state) {
+        state.on = true;
+        state.r = static_cast<uint8_t>(r);
+        state.g = static_cast<uint8_t>(g);
+        state.b = static_cast<uint8_t>(b);
+    });
+}
+
+std::future<bool> LEDManager::RequestState(const std::string& address, const StateUpdate& update) {
+    std::promise<bool> promise;
+    std::future<bool> result = promise.get_future();
+    bool submit = false;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        DeviceState& state = states_[address];
+        update(state.desired);
+        if (!running_) {
+            // Stop has already failed the waiters and the workers won't sync again
+            promise.set_value(false);
+            return result;
+        }
+        state.waiters.emplace_back(++state.generation, std::move(promise));
+        if (state.sync_queued) {
+            // The queued sync hasn't read the desired state yet and will pick this up
+            state.coalesced++;
+        } else {
+            state.sync_queued = true;
+            submit = true;
+        }
+    }
+    if (submit) {
+        workers_.at(address)->Submit([this, address] { return SyncDevice(address); });
+    }
+    return result;
+}
+
+bool LEDManager::SyncDevice(const std::string& address) {
+    // Hold off until the link has had time for the previous write. Commands that
+    // arrive meanwhile land in the desired state and go out with this sync.
+    std::chrono::steady_clock::time_point earliest;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        earliest = states_[address].last_write + MIN_WRITE_INTERVAL;
+    }
+    std::this_thread::sleep_until(earliest);
+
+    LightState target;
+    std::optional<LightState> current;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        DeviceState& state = states_[address];
+        target = state.desired;
+        current = state.acknowledged;
+        generation = state.generation;
+        state.sync_queued = false;
+    }
+
+    auto device = FindDevice(address);
+    size_t writes = 0;
+    bool ok = device && device->ApplyState(current, target, writes);
+
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    DeviceState& state = states_[address];
+    if (ok) {
+        state.acknowledged = target;
+    } else {
+        // A partial write leaves the bulb in an unknown state
+        state.acknowledged.reset();
+    }
+    if (writes > 0) {
+        state.last_write = std::chrono::steady_clock::now();
+        state.writes += writes;
+    } else if (ok) {
+        state.skipped++;
+    }
+
+    auto& waiters = state.waiters;
+    auto covered = std::partition(waiters.begin(), waiters.end(),
+        [generation](const auto& waiter) { return waiter.first > generation; });
+    for (auto it = covered; it != waiters.end(); ++it) {
+        it->second.set_value(ok);
+    }
+    waiters.erase(covered, waiters.end());
+    return ok;
+}
+
+void LEDManager::ResyncDevice(const std::string& address) {
+    bool submit = false;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        DeviceState& state = states_[address];
+        state.acknowledged.reset();
+        // Only restore a state that was asked for
+        if (state.generation > 0 && !state.sync_queued) {
+            state.sync_queued = true;
+            submit = true;
+        }
+    }
+    if (submit) {
+        DEBUG_LOG("Restoring desired state on device " + address);
+        workers_.at(address)->Submit([this, address] { return SyncDevice(address); });
+    }
+}
+
+json LEDManager::WriteStats() {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    json stats = json::object();
+    for (const auto& [address, state] : states_) {
+        stats[address] = {
+            {"writes", state.writes},
+            {"skipped", state.skipped},
+            {"coalesced", state.coalesced}
+        };
+    }
+    return stats;
+}
+
+json LEDManager::ApplyScene(const std::string& command, const json& params) {
+    if (!params.contains("devices") || !params["devices"].is_object()) {
+        ERROR_LOG("Missing or invalid 'devices' in " + command + " command");
+        return nullptr;
+    }
+
+    StateUpdates updates;
+    for (const auto& [address, target] : params["devices"].items()) {
+        if (!workers_.count(address)) {
+            WARN_LOG("Ignoring unknown device in " + command + ": " + address);
+            continue;
+        }
+        // Validate now, the update runs under the state lock
+        LightState fields;
+        bool has_on = target.contains("on");
+        bool has_r = target.contains("r");
+        bool has_g = target.contains("g");
+        bool has_b = target.contains("b");
+        bool has_color = has_r || has_g || has_b;
+        bool has_brightness = target.contains("brightness");
+        if (has_on) fields.on = target["on"].get<bool>();
+        if (has_r) fields.r = static_cast<uint8_t>(std::clamp(target["r"].get<int>(), 0, 255));
+        if (has_g) fields.g = static_cast<uint8_t>(std::clamp(target["g"].get<int>(), 0, 255));
+        if (has_b) fields.b = static_cast<uint8_t>(std::clamp(target["b"].get<int>(), 0, 255));
+        if (has_brightness) fields.brightness = static_cast<uint8_t>(std::clamp(target["brightness"].get<int>(), 0, 100));
+
+        updates[address] = [fields, has_on, has_r, has_g, has_b, has_color, has_brightness](LightState& state) {
+            // A channel left out keeps its current value
+            if (has_r) state.r = fields.r;
+            if (has_g) state.g = fields.g;
+            if (has_b) state.b = fields.b;
+            if (has_brightness) state.brightness = fields.brightness;
+            // A color or brightness alone implies on, like set_color
+            state.on = has_on ? fields.on : (state.on || has_color || has_brightness);
+        };
+    }
+
+    INFO_LOG("Applying " + command + " to " + std::to_string(updates.size()) + " devices");
+    return FanOut(command, updates);
+}
+
+json LEDManager::FanOut(const std::string& command, const StateUpdate& update) {
+    StateUpdates updates;
+    for (const auto& config : device_configs_) {
+        // Every configured device gets the new desired state, even one that is
+        // currently missing, so it catches up when it comes back
+        updates[config.address_] = update;
+    }
+    return FanOut(command, updates);
+}
+
+json LEDManager::FanOut(const std::string& command, const StateUpdates& updates) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::pair<std::string, std::future<bool>>> pending;
+    for (const auto& [address, update] : updates) {
+        pending.emplace_back(address, RequestState(address, update));
+    }
+
+    // Every device has the same deadline, the command takes as long as the slowest bulb
+    const auto deadline = start + DEVICE_COMMAND_TIMEOUT;
+    json results = json::object();
+    int succeeded = 0;
+    for (auto& [address, result] : pending) {
+        std::string status;
+        if (result.wait_until(deadline) != std::future_status::ready) {
+            status = "timeout";
+            WARN_LOG("Device " + address + " timed out on " + command);
+        } else {
+            try {
+                status = result.get() ? "ok" : "failed";
+            } catch (const std::exception&) {
+                // Stopped before the device synced
+                status = "failed";
+            }
+        }
+        if (status == "failed" && !FindDevice(address)) {
+            status = "missing";
+        }
+        succeeded += status == "ok";
+        results[address] = status;
+        if (status != "ok" && status != "missing") {
+            RequestReconnect(address);
+        }
+    }
+
+    const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    json report = {
+        {"command", command},
+        {"results", results},
+        {"succeeded", succeeded},
+        {"total", pending.size()},
+        {"elapsed_ms", elapsed_ms}
+    };
+    INFO_LOG(command + " finished on " + std::to_string(succeeded) + "/" +
+             std::to_string(pending.size()) + " devices in " + std::to_string(elapsed_ms) + "ms");
+
+    try {
+        Publish(std::string(LED_STATE_TOPIC_PREFIX) + "state", report);
+    } catch (const std::exception& e) {
+        ERROR_LOG("Failed to publish state report: " + std::string(e.what()));
     }
+    return report;
 }
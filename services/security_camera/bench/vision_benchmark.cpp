@@ -0,0 +1,235 @@
+// Offline benchmark for the vision pipeline. Drives the same capture -> motion ->
+// inference -> tracking -> encode/publish path the service runs from a
+// FrameSource, so model and encoder changes can be compared off the Pi.
+//
+// Usage: vision_benchmark [--frames N] [--fps N] [--size WxH] [--model NAME]
+//                         [--regions SPEC] [--tile] [--motion-gate] [--no-inference] [source]
+//
+// source is "pattern" (default), a directory of images or a video file. Without
+// --fps frames are produced as fast as the pipeline takes them. The model paths
+// can be overridden with DETECTION_MODEL_PATH, DETECTION_MODEL_CONFIG and
+// DETECTION_MODEL_CLASSES as in the service. --regions and --tile take the
+// DETECTION_REGIONS format and DETECTION_TILING switch.
+
+#include "frame_broadcaster.h"
+#include "frame_processor.h"
+#include "frame_source.h"
+#include "log.h"
+#include "motion_detector.h"
+#include "object_tracker.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Per-stage samples in milliseconds, in the order stages are reported
+class StageTimes {
+public:
+    void Record(const std::string& stage, Clock::time_point start) {
+        if (samples_.find(stage) == samples_.end()) {
+            order_.push_back(stage);
+        }
+        samples_[stage].push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+
+    void Print() {
+        std::printf("\n%-10s %8s %9s %9s %9s %9s %9s\n", "stage", "count", "mean_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+        for (const auto& stage : order_) {
+            auto& samples = samples_[stage];
+            std::sort(samples.begin(), samples.end());
+            double sum = 0.0;
+            for (double sample : samples) {
+                sum += sample;
+            }
+            std::printf("%-10s %8zu %9.2f %9.2f %9.2f %9.2f %9.2f\n", stage.c_str(), samples.size(),
+                        sum / samples.size(), Percentile(samples, 0.50), Percentile(samples, 0.90),
+                        Percentile(samples, 0.99), samples.back());
+        }
+    }
+
+private:
+    std::vector<std::string> order_;
+    std::map<std::string, std::vector<double>> samples_;
+
+    static double Percentile(const std::vector<double>& sorted, double p) {
+        return sorted.empty() ? 0.0 : sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+    }
+};
+
+long PeakRssKb() {
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    // Linux reports kilobytes
+    return usage.ru_maxrss;
+}
+
+ModelConfig LoadModelConfig(const std::string& name) {
+    ModelConfig config = ModelConfig::FromName(name);
+    if (const char* path = std::getenv("DETECTION_MODEL_PATH")) config.model_path = path;
+    if (const char* path = std::getenv("DETECTION_MODEL_CONFIG")) config.config_path = path;
+    if (const char* path = std::getenv("DETECTION_MODEL_CLASSES")) config.classes_path = path;
+    return config;
+}
+
+void Usage(const char* argv0) {
+    std::fprintf(stderr, "Usage: %s [--frames N] [--fps N] [--size WxH] [--model NAME] "
+                         "[--regions SPEC] [--tile] [--motion-gate] [--no-inference] [source]\n", argv0);
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string source_spec = "pattern";
+    std::string model_name = "yolov3";
+    int frames = 300;
+    int fps = 0;
+    int width = 640;
+    int height = 480;
+    bool motion_gate = false;
+    bool inference = true;
+    InferenceRegions regions;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--fps" && i + 1 < argc) {
+            fps = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--size" && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+                Usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--model" && i + 1 < argc) {
+            model_name = argv[++i];
+        } else if (arg == "--regions" && i + 1 < argc) {
+            regions.regions = ParseRegions(argv[++i]);
+        } else if (arg == "--tile") {
+            regions.tile = true;
+        } else if (arg == "--motion-gate") {
+            motion_gate = true;
+        } else if (arg == "--no-inference") {
+            inference = false;
+        } else if (arg.rfind("--", 0) == 0) {
+            Usage(argv[0]);
+            return 1;
+        } else {
+            source_spec = arg;
+        }
+    }
+
+    try {
+        FrameSource source(source_spec, width, height, fps > 0 ? fps : 15, fps > 0);
+        if (!source.Open()) {
+            return 1;
+        }
+
+        FrameProcessor processor(LoadModelConfig(model_name));
+        if (inference && !processor.Initialize()) {
+            ERROR_LOG("Failed to load model " + model_name);
+            return 1;
+        }
+
+        MotionDetector motion;
+        ObjectTracker tracker;
+        FrameBroadcaster broadcaster;
+        StageTimes times;
+        long rss_before_kb = PeakRssKb();
+
+        int inferred = 0;
+        int detections = 0;
+        int events = 0;
+        int snapshots = 0;
+        size_t encoded_bytes = 0;
+        size_t published_bytes = 0;
+
+        auto start = Clock::now();
+        for (int n = 0; n < frames; ++n) {
+            auto frame_start = Clock::now();
+
+            auto stage_start = Clock::now();
+            if (!source.Grab()) {
+                break;
+            }
+            cv::Mat frame = source.Retrieve();
+            times.Record("capture", stage_start);
+            if (frame.empty()) {
+                continue;
+            }
+
+            // Viewers and the clip recorder share one encode per frame
+            stage_start = Clock::now();
+            const uint8_t* jpeg = nullptr;
+            size_t jpeg_size = 0;
+            EncodedFramePtr encoded = source.GetEncoded(jpeg, jpeg_size)
+                ? broadcaster.PublishEncoded(jpeg, jpeg_size, frame.cols, frame.rows)
+                : broadcaster.Publish(frame);
+            times.Record("encode", stage_start);
+            if (encoded) {
+                encoded_bytes += encoded->jpeg.size();
+            }
+
+            stage_start = Clock::now();
+            bool moving = motion.Detect(frame).motion;
+            times.Record("motion", stage_start);
+
+            if (inference && (moving || !motion_gate)) {
+                stage_start = Clock::now();
+                cv::Mat annotated = frame.clone();
+                DetectionResult result = processor.ProcessFrame(annotated, &regions);
+                times.Record("inference", stage_start);
+                inferred++;
+                detections += static_cast<int>(result.detections.size());
+
+                stage_start = Clock::now();
+                TrackerOutput output = tracker.Update(result.detections, annotated);
+                times.Record("tracking", stage_start);
+                events += static_cast<int>(output.events.size());
+
+                // What the service would put on the wire for this frame
+                stage_start = Clock::now();
+                if (!output.events.empty()) {
+                    nlohmann::json message = result.ToJson();
+                    for (const auto& event : output.events) {
+                        message["events"].push_back(event.ToJson());
+                    }
+                    published_bytes += message.dump().size();
+                }
+                for (const auto& snapshot : output.snapshots) {
+                    std::vector<uchar> buffer;
+                    cv::imencode(".jpg", snapshot.frame, buffer, {cv::IMWRITE_JPEG_QUALITY, 80});
+                    published_bytes += buffer.size();
+                    snapshots++;
+                }
+                times.Record("publish", stage_start);
+            }
+
+            times.Record("total", frame_start);
+        }
+        double wall_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+        times.Print();
+        std::printf("\nsource: %s, %dx%d, %llu frames in %.2fs (%.1f frames/s)\n", source_spec.c_str(),
+                    source.Width(), source.Height(), static_cast<unsigned long long>(source.Frames()), wall_s,
+                    wall_s > 0 ? source.Frames() / wall_s : 0.0);
+        std::printf("inference: %d frames (%.1f/s), %d detections, %d track events, %d snapshots\n",
+                    inferred, wall_s > 0 ? inferred / wall_s : 0.0, detections, events, snapshots);
+        std::printf("bytes: %.1f KB/frame encoded, %zu published\n",
+                    source.Frames() > 0 ? encoded_bytes / 1024.0 / source.Frames() : 0.0, published_bytes);
+        std::printf("peak RSS: %.1f MB (%.1f MB before the run)\n", PeakRssKb() / 1024.0, rss_before_kb / 1024.0);
+    } catch (const std::exception& e) {
+        ERROR_LOG("Benchmark failed: " + std::string(e.what()));
+        return 1;
+    }
+
+    return 0;
+}
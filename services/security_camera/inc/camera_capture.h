@@ -3,15 +3,39 @@
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <atomic>
+#include <memory>
+
+#include "frame_source.h"
+#include "v4l2_capture.h"
+
+enum class CaptureBackend {
+    OPENCV,
+    V4L2,
+    // Generated or recorded frames, see FrameSource
+    SOURCE
+};
 
 class CameraCapture {
 public:
-    CameraCapture(int camera_id = 0, int width = 640, int height = 480, int fps = 15);
+    // mjpeg only applies to the V4L2 backend, source only to the SOURCE backend
+    CameraCapture(int camera_id = 0, int width = 640, int height = 480, int fps = 15,
+                  CaptureBackend backend = CaptureBackend::OPENCV, bool mjpeg = false,
+                  const std::string& source = "");
     ~CameraCapture();
 
     bool Initialize();
     cv::Mat CaptureFrame();
     bool IsOpened() const;
+
+    // Split capture: GrabFrame blocks until the device delivers the next frame,
+    // RetrieveFrame decodes it. Frames that are grabbed but never retrieved are dropped cheaply.
+    bool GrabFrame();
+    cv::Mat RetrieveFrame();
+
+    // Compressed bytes of the last grabbed frame when the device delivers MJPEG and
+    // the frame is used unmodified, so the stream path can skip re-encoding.
+    // Valid until the next GrabFrame().
+    bool GetEncodedFrame(const uint8_t*& data, size_t& size) const;
     
     // Night mode settings
     void SetNightMode(bool enabled);
@@ -23,9 +47,17 @@ public:
     // Camera settings
     void SetResolution(int width, int height);
     void SetFPS(int fps);
+    int GetFPS() const;
+    int GetWidth() const;
+    int GetHeight() const;
     
 private:
     cv::VideoCapture cap_;
+    std::unique_ptr<V4L2Capture> v4l2_;
+    std::unique_ptr<FrameSource> source_;
+    CaptureBackend backend_;
+    bool mjpeg_;
+    std::string source_spec_;
     int camera_id_;
     int width_;
     int height_;
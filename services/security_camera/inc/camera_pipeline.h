@@ -0,0 +1,106 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera_capture.h"
+#include "clip_recorder.h"
+#include "frame_broadcaster.h"
+#include "frame_channel.h"
+#include "inference_pool.h"
+#include "motion_detector.h"
+#include "object_tracker.h"
+#include "regions.h"
+
+struct CameraConfig {
+    std::string id{"0"};
+    int device{0};
+    int width{640};
+    int height{480};
+    int fps{15};
+    CaptureBackend backend{CaptureBackend::OPENCV};
+    bool mjpeg{false};
+    // Spec for the SOURCE backend, see FrameSource
+    std::string source;
+
+    // Motion gating, threshold is the fraction of the watched area that must change
+    bool motion_enabled{true};
+    double motion_threshold{0.01};
+    int motion_hold_ms{2000};
+    std::vector<Region> motion_regions;
+
+    // Inference cropping and tiling, the whole frame when empty
+    InferenceRegions inference;
+
+    TrackerConfig tracker;
+    ClipConfig clips;
+};
+
+// Everything owned by a single camera: the capture thread, its stream
+// broadcaster and the motion gate in front of the shared inference pool.
+class CameraPipeline {
+public:
+    using FrameCallback = std::function<void()>;
+    using MotionCallback = std::function<void(size_t camera, bool motion, double score)>;
+
+    CameraPipeline(size_t index, const CameraConfig& config, InferencePool& inference_pool,
+                   FrameCallback on_broadcast, MotionCallback on_motion,
+                   ClipRecorder::ClipCallback on_clip = nullptr);
+    ~CameraPipeline();
+
+    bool Initialize();
+    void Start();
+    void Stop();
+
+    // Encode frames for stream viewers while enabled
+    void SetStreaming(bool streaming);
+
+    size_t Index() const;
+    const std::string& Id() const;
+    CameraCapture& Capture();
+    FrameBroadcaster& Broadcaster();
+    ObjectTracker& Tracker();
+    // Held while tracker output is produced and published, so a camera's
+    // detection, exit and clip messages go out in the order they happened
+    std::mutex& TrackingMutex();
+    ClipRecorder& Recorder();
+    cv::Mat LatestFrame() const;
+
+    bool IsMotionActive() const;
+    void SetMotionThreshold(double threshold);
+
+    CameraPipeline(const CameraPipeline&) = delete;
+    CameraPipeline& operator=(const CameraPipeline&) = delete;
+
+private:
+    size_t index_;
+    CameraConfig config_;
+    InferencePool& inference_pool_;
+    FrameCallback on_broadcast_;
+    MotionCallback on_motion_;
+
+    std::unique_ptr<CameraCapture> camera_capture_;
+    FrameBroadcaster frame_broadcaster_;
+    FrameChannel frame_channel_;
+    ObjectTracker tracker_;
+    std::mutex tracking_mutex_;
+    ClipRecorder recorder_;
+
+    std::unique_ptr<MotionDetector> motion_detector_;
+    std::atomic<bool> motion_active_{false};
+    std::chrono::steady_clock::time_point last_motion_time_;
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> streaming_{false};
+    std::thread capture_thread_;
+
+    void CaptureLoop();
+    bool UpdateMotion(const cv::Mat& frame);
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+#include "frame_broadcaster.h"
+
+struct ClipConfig {
+    bool enabled{false};
+    std::string directory{"/var/lib/security_camera/clips"};
+    // Frames kept per second, the rest are not encoded for the clip
+    int fps{5};
+    int pre_event_s{5};
+    // Recording continues this long after the last trigger
+    int post_event_s{10};
+    int max_clip_s{120};
+    // Cap on encoded bytes held in memory, ring and unwritten frames together
+    size_t memory_budget_bytes{32 * 1024 * 1024};
+    // Frames are written to disk in batches of at least this size
+    size_t write_batch_bytes{1024 * 1024};
+};
+
+// Event clips with pre-roll. The last pre_event_s seconds of encoded frames stay
+// in a byte-budgeted ring; a trigger flushes the ring into a new clip and later
+// frames follow until post_event_s after the last trigger. Frames are the
+// broadcaster's shared JPEG buffers, nothing is re-encoded. A writer thread
+// appends them to a concatenated MJPEG file in large sequential batches.
+class ClipRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+    // {"camera", "clip_id", "status": "recording"|"complete"|"failed", "path", "started",
+    //  "duration_s", "frames", "bytes", "pre_event_frames", "dropped_frames", "trigger"}
+    using ClipCallback = std::function<void(const nlohmann::json& clip)>;
+
+    ClipRecorder(const std::string& camera, const ClipConfig& config, ClipCallback on_clip);
+    ~ClipRecorder();
+
+    void Start();
+    void Stop();
+
+    bool Enabled() const;
+    // Whether a frame captured now should be encoded and pushed, paces to config fps
+    bool WantsFrame(Clock::time_point now);
+    void Push(const EncodedFramePtr& frame);
+    // Start a clip, or extend the running one. reason is reported with a new clip.
+    void Trigger(const nlohmann::json& reason = nullptr);
+    // Extend the running clip, never starts one
+    void Extend();
+
+    bool Recording() const;
+    // {"recording", "ring_frames", "ring_bytes", "pending_bytes", "clips", "dropped_frames"}
+    nlohmann::json Metrics() const;
+
+    ClipRecorder(const ClipRecorder&) = delete;
+    ClipRecorder& operator=(const ClipRecorder&) = delete;
+
+private:
+    struct Clip {
+        uint64_t id{0};
+        std::string path;
+        std::time_t started{0};
+        Clock::time_point first_frame;
+        Clock::time_point last_frame;
+        Clock::time_point last_trigger;
+        nlohmann::json trigger;
+        uint64_t frames{0};
+        uint64_t bytes{0};
+        uint64_t pre_event_frames{0};
+        uint64_t dropped{0};
+        bool failed{false};
+    };
+
+    // A frame headed for the clip file at path, or the end of the clip when frame is null
+    struct WriteItem {
+        EncodedFramePtr frame;
+        std::string path;
+        Clip clip;
+    };
+
+    std::string camera_;
+    ClipConfig config_;
+    ClipCallback on_clip_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable writer_cv_;
+    std::deque<EncodedFramePtr> ring_;
+    size_t ring_bytes_{0};
+    std::deque<WriteItem> pending_;
+    size_t pending_bytes_{0};
+    bool recording_{false};
+    Clip clip_;
+    uint64_t next_clip_id_{1};
+    uint64_t clips_{0};
+    uint64_t dropped_{0};
+    Clock::time_point next_frame_time_;
+
+    bool running_{false};
+    std::thread writer_thread_;
+    // Writer thread only
+    std::FILE* file_{nullptr};
+    std::string file_path_;
+
+    // Caller holds mutex_
+    void TrimRing(Clock::time_point now);
+    void StartClip(Clock::time_point now, const nlohmann::json& reason);
+    void QueueFrame(const EncodedFramePtr& frame);
+    void FinishClip();
+
+    void WriterLoop();
+    bool WriteFrame(const WriteItem& item);
+    void CloseClip(const Clip& clip);
+    nlohmann::json ClipJson(const Clip& clip, const std::string& status) const;
+};
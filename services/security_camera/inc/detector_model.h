@@ -0,0 +1,135 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Detection {
+    int class_id{-1};
+    std::string class_name;
+    float confidence{0.0f};
+    cv::Rect box;
+};
+
+enum class ModelType {
+    YOLO_DARKNET,
+    YOLOV8_ONNX,
+    SSD_CAFFE
+};
+
+struct ModelConfig {
+    std::string name{"yolov3"};
+    ModelType type{ModelType::YOLO_DARKNET};
+    std::string model_path{"/usr/local/lib/security_camera/yolov3.weights"};
+    std::string config_path{"/usr/local/lib/security_camera/yolov3.cfg"};
+    // Optional file with one class name per line, the model's default labels are used otherwise
+    std::string classes_path;
+    cv::Size input_size{416, 416};
+    float conf_threshold{0.5f};
+    float nms_threshold{0.45f};
+    // Classes to report, an empty list keeps every class the model knows
+    std::vector<std::string> allowed_classes{"person", "car", "truck", "bus", "motorcycle", "dog", "cat", "bird"};
+
+    // Presets: yolov3, yolov4-tiny, yolov8n, mobilenet-ssd
+    static ModelConfig FromName(const std::string& name);
+};
+
+// Raw decoder output, kept as parallel arrays so NMS can run before any
+// Detection (and its class name string) is built
+struct DetectionCandidates {
+    std::vector<cv::Rect> boxes;
+    std::vector<float> scores;
+    std::vector<int> class_ids;
+
+    void Add(const cv::Rect& box, float score, int class_id);
+    void Clear();
+};
+
+// A DNN detector together with its preprocessing and output decoding.
+// Subclasses only describe how to load the network and read its outputs.
+class DetectorModel {
+public:
+    explicit DetectorModel(const ModelConfig& config);
+    virtual ~DetectorModel() = default;
+
+    static std::unique_ptr<DetectorModel> Create(const ModelConfig& config);
+
+    bool Load();
+    std::vector<Detection> Detect(const cv::Mat& frame);
+    // One forward pass for several frames, which may have different sizes
+    std::vector<std::vector<Detection>> DetectBatch(const std::vector<cv::Mat>& frames);
+
+    const ModelConfig& Config() const;
+    const std::vector<std::string>& ClassNames() const;
+
+    DetectorModel(const DetectorModel&) = delete;
+    DetectorModel& operator=(const DetectorModel&) = delete;
+
+protected:
+    ModelConfig config_;
+    cv::dnn::Net net_;
+    std::vector<std::string> class_names_;
+    std::vector<cv::String> output_names_;
+
+    // One bit per class id, set when the class is in allowed_classes
+    std::vector<bool> class_mask_;
+    DetectionCandidates candidates_;
+
+    // Blob preprocessing
+    double scale_{1.0 / 255.0};
+    cv::Scalar mean_;
+    bool swap_rb_{true};
+    // Networks with a built-in DetectionOutput layer are already suppressed
+    bool apply_nms_{true};
+
+    virtual cv::dnn::Net ReadNet() const = 0;
+    virtual std::vector<std::string> DefaultClassNames() const = 0;
+    // Decode the outputs belonging to image batch_index of a batch of batch_size
+    virtual void Decode(const std::vector<cv::Mat>& outs, int batch_index, int batch_size,
+                        const cv::Size& frame_size, DetectionCandidates& candidates) const = 0;
+
+    bool IsClassAllowed(int class_id) const;
+    std::string ClassName(int class_id) const;
+
+private:
+    void BuildClassMask();
+    std::vector<Detection> Suppress(const DetectionCandidates& candidates) const;
+};
+
+// YOLOv3 / YOLOv4-tiny in Darknet format, region outputs with normalized boxes
+class YoloDarknetModel : public DetectorModel {
+public:
+    explicit YoloDarknetModel(const ModelConfig& config);
+
+protected:
+    cv::dnn::Net ReadNet() const override;
+    std::vector<std::string> DefaultClassNames() const override;
+    void Decode(const std::vector<cv::Mat>& outs, int batch_index, int batch_size,
+                const cv::Size& frame_size, DetectionCandidates& candidates) const override;
+};
+
+// Ultralytics YOLOv8 exported to ONNX, a single [1, 4 + classes, N] output in input pixels
+class YoloV8OnnxModel : public DetectorModel {
+public:
+    explicit YoloV8OnnxModel(const ModelConfig& config);
+
+protected:
+    cv::dnn::Net ReadNet() const override;
+    std::vector<std::string> DefaultClassNames() const override;
+    void Decode(const std::vector<cv::Mat>& outs, int batch_index, int batch_size,
+                const cv::Size& frame_size, DetectionCandidates& candidates) const override;
+};
+
+// MobileNet-SSD (Caffe), a DetectionOutput layer of [image, label, conf, x1, y1, x2, y2] rows
+class SsdModel : public DetectorModel {
+public:
+    explicit SsdModel(const ModelConfig& config);
+
+protected:
+    cv::dnn::Net ReadNet() const override;
+    std::vector<std::string> DefaultClassNames() const override;
+    void Decode(const std::vector<cv::Mat>& outs, int batch_index, int batch_size,
+                const cv::Size& frame_size, DetectionCandidates& candidates) const override;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A single JPEG-encoded frame shared by every consumer. The multipart header
+// is built once alongside the JPEG bytes so stream clients only have to write.
+struct EncodedFrame {
+    uint64_t sequence{0};
+    std::chrono::steady_clock::time_point timestamp;
+    int width{0};
+    int height{0};
+    std::string part_header;
+    std::vector<uchar> jpeg;
+
+    static constexpr const char* PART_TRAILER = "\r\n";
+    static constexpr size_t PART_TRAILER_SIZE = 2;
+};
+
+using EncodedFramePtr = std::shared_ptr<const EncodedFrame>;
+
+// Encodes each published frame exactly once and hands out the same refcounted
+// buffer to all readers, so the cost of streaming does not grow per viewer.
+class FrameBroadcaster {
+public:
+    explicit FrameBroadcaster(int jpeg_quality = 80);
+    ~FrameBroadcaster() = default;
+
+    // Encode and publish a new frame. Returns the published frame or nullptr on failure.
+    EncodedFramePtr Publish(const cv::Mat& frame);
+
+    // Publish a frame that is already JPEG-compressed (e.g. MJPEG from the camera)
+    EncodedFramePtr PublishEncoded(const uint8_t* jpeg, size_t size, int width, int height);
+
+    // Latest encoded frame, or nullptr if nothing has been published yet
+    EncodedFramePtr Latest() const;
+    void Reset();
+
+    FrameBroadcaster(const FrameBroadcaster&) = delete;
+    FrameBroadcaster& operator=(const FrameBroadcaster&) = delete;
+
+private:
+    std::vector<int> encode_params_;
+    std::atomic<uint64_t> sequence_{0};
+
+    mutable std::mutex latest_mutex_;
+    EncodedFramePtr latest_;
+
+    EncodedFramePtr Finalize(std::shared_ptr<EncodedFrame> encoded, int width, int height);
+};
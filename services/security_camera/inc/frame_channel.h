@@ -0,0 +1,24 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <mutex>
+
+// Holds the most recent captured frame for consumers that only ever want the
+// freshest one (snapshots), frames for inference go through InferencePool.
+class FrameChannel {
+public:
+    FrameChannel() = default;
+    ~FrameChannel() = default;
+
+    // Replace the latest frame. It is shared with readers and must not be modified in place.
+    void Publish(const cv::Mat& frame);
+
+    cv::Mat Latest() const;
+
+    FrameChannel(const FrameChannel&) = delete;
+    FrameChannel& operator=(const FrameChannel&) = delete;
+
+private:
+    mutable std::mutex mutex_;
+    cv::Mat frame_;
+};
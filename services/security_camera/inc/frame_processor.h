@@ -1,41 +1,76 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
-#include <opencv2/dnn.hpp>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include <nlohmann/json.hpp>
+#include "detector_model.h"
+#include "regions.h"
 
 using json = nlohmann::json;
 
-struct Detection {
-    std::string class_name;
-    float confidence;
-    cv::Rect box;
-};
-
 struct DetectionResult {
     std::vector<Detection> detections;
     double fps{0.0};
     double latency_ms{0.0};
+    // When the frame was captured, set by InferencePool
+    std::chrono::steady_clock::time_point captured{};
     
     json ToJson() const;
 };
 
+// The part of a frame that is run through the model. With regions only their
+// bounding boxes are inferred and detections whose ground point (bottom centre)
+// falls outside every polygon are dropped. With tile the inferred area is cut
+// into model-input-sized tiles so small objects keep their native resolution.
+struct InferenceRegions {
+    std::vector<Region> regions;
+    bool tile{false};
+    // Fraction shared by neighbouring tiles so an object on a seam is seen whole in one
+    float tile_overlap{0.2f};
+    // Tiles per frame before they are grown (and downscaled) to bound the cost
+    int max_tiles{6};
+
+    // Nothing to crop, the whole frame is resized to the model input as before
+    bool FullFrame() const { return regions.empty() && !tile; }
+};
+
 class FrameProcessor {
 public:
-    FrameProcessor();
+    explicit FrameProcessor(const ModelConfig& config = ModelConfig());
     ~FrameProcessor();
 
     bool Initialize();
-    DetectionResult ProcessFrame(cv::Mat& frame);
+    DetectionResult ProcessFrame(cv::Mat& frame, const InferenceRegions* regions = nullptr);
+    // Run several frames through a single forward pass, detections are drawn onto each frame.
+    // regions is empty or holds one entry (null for the full frame) per frame.
+    std::vector<DetectionResult> ProcessBatch(std::vector<cv::Mat>& frames,
+                                              const std::vector<const InferenceRegions*>& regions = {});
     
 private:
-    cv::dnn::Net net_;
-    std::vector<std::string> class_names_;
-    float conf_threshold_{0.5};
+    ModelConfig config_;
+    std::unique_ptr<DetectorModel> model_;
+    
+    // Frames per second through this processor
+    std::chrono::steady_clock::time_point fps_window_start_{std::chrono::steady_clock::now()};
+    int fps_frame_count_{0};
+    double fps_{0.0};
+    
+    // Crops of every frame share one forward pass
+    std::vector<cv::Mat> crops_;
+    std::vector<std::pair<size_t, cv::Point>> crop_origins_;
     
     // Helper methods
     std::vector<Detection> Detect(const cv::Mat& frame);
+    std::vector<std::vector<Detection>> DetectRegions(const std::vector<cv::Mat>& frames,
+                                                      const std::vector<const InferenceRegions*>& regions);
+    std::vector<cv::Rect> PlanCrops(const cv::Size& frame_size, const InferenceRegions& regions) const;
+    // Drop duplicates from overlapping crops and detections outside the regions
+    void MergeDetections(std::vector<Detection>& detections, const cv::Size& frame_size,
+                         const InferenceRegions& regions, bool overlapping) const;
+    double UpdateFPS(int frames, std::chrono::steady_clock::time_point now);
     void DrawDetections(cv::Mat& frame, const std::vector<Detection>& detections);
 };
\ No newline at end of file
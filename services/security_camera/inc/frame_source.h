@@ -0,0 +1,71 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frames without a camera, for running the pipeline on a build machine.
+// The spec picks the source:
+//   "pattern"        generated scene with a moving object, at the configured size
+//   a directory      every .jpg/.jpeg/.png/.bmp in it, in name order
+//   any other path   a video file OpenCV can read (MJPEG AVI with the bundled build)
+// Grab paces delivery to fps like a device would unless realtime is off.
+class FrameSource {
+public:
+    enum class Kind {
+        PATTERN,
+        IMAGES,
+        VIDEO
+    };
+
+    FrameSource(const std::string& spec, int width, int height, int fps,
+                bool realtime = true, bool loop = true);
+    ~FrameSource() = default;
+
+    bool Open();
+    bool IsOpened() const;
+
+    // Advance to the next frame, false once a non-looping source runs out
+    bool Grab();
+    cv::Mat Retrieve();
+
+    // Compressed bytes of the current frame for JPEG images, mirroring MJPEG
+    // devices. Valid until the next Grab().
+    bool GetEncoded(const uint8_t*& data, size_t& size) const;
+
+    Kind GetKind() const;
+    uint64_t Frames() const;
+    int Width() const;
+    int Height() const;
+    int FPS() const;
+
+    FrameSource(const FrameSource&) = delete;
+    FrameSource& operator=(const FrameSource&) = delete;
+
+private:
+    std::string spec_;
+    Kind kind_{Kind::PATTERN};
+    int width_;
+    int height_;
+    int fps_;
+    bool realtime_;
+    bool loop_;
+    bool opened_{false};
+
+    uint64_t frames_{0};
+    std::chrono::steady_clock::time_point next_frame_time_;
+
+    cv::VideoCapture video_;
+    std::vector<std::string> images_;
+    size_t image_index_{0};
+    std::vector<uchar> image_bytes_;
+    bool image_is_jpeg_{false};
+    cv::Mat background_;
+
+    bool GrabImage();
+    bool GrabVideo();
+    cv::Mat RenderPattern() const;
+};
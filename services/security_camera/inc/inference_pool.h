@@ -0,0 +1,86 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_processor.h"
+#include "inference_scheduler.h"
+
+// Shared detector for every camera. The scheduler decides which frames are
+// worth inferring, each camera has a small bounded queue that drops its oldest
+// frame when full; workers take up to one frame per camera per round and run
+// them through a single batched forward pass.
+class InferencePool {
+public:
+    // Called on a worker thread with the annotated frame and its detections
+    using ResultCallback = std::function<void(size_t camera, const cv::Mat& frame, const DetectionResult& result)>;
+
+    InferencePool(const ModelConfig& config, size_t num_cameras, size_t max_batch = 4,
+                  size_t queue_depth = 2, int num_workers = 1,
+                  const SchedulerConfig& schedule = SchedulerConfig());
+    ~InferencePool();
+
+    // Load one model per worker
+    bool Initialize();
+    void Start(ResultCallback callback);
+    void Stop();
+
+    // Restrict a camera's inference to regions of its frames, call before Start
+    void SetRegions(size_t camera, const InferenceRegions& regions);
+
+    // Queue a frame for detection. The frame is not modified, captured is handed
+    // back in DetectionResult::captured.
+    void Submit(size_t camera, const cv::Mat& frame,
+                std::chrono::steady_clock::time_point captured = std::chrono::steady_clock::now());
+
+    // Ask before Submit, see InferenceScheduler::ShouldInfer
+    InferenceScheduler& Scheduler();
+
+    uint64_t DroppedFrames(size_t camera) const;
+    size_t QueueDepth(size_t camera) const;
+
+    InferencePool(const InferencePool&) = delete;
+    InferencePool& operator=(const InferencePool&) = delete;
+
+private:
+    struct QueuedFrame {
+        cv::Mat frame;
+        std::chrono::steady_clock::time_point captured;
+    };
+
+    struct CameraQueue {
+        std::deque<QueuedFrame> frames;
+        uint64_t dropped{0};
+        InferenceRegions regions;
+    };
+
+    ModelConfig config_;
+    size_t max_batch_;
+    size_t queue_depth_;
+    std::vector<std::unique_ptr<FrameProcessor>> processors_;
+    std::vector<std::thread> workers_;
+    ResultCallback callback_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queue_cv_;
+    std::vector<CameraQueue> queues_;
+    InferenceScheduler scheduler_;
+    size_t next_camera_{0};
+    size_t pending_{0};
+    std::atomic<bool> running_{false};
+
+    void WorkerLoop(FrameProcessor* processor);
+    // Take a batch round-robin across cameras, caller holds mutex_
+    void TakeBatch(std::vector<cv::Mat>& frames, std::vector<size_t>& cameras,
+                   std::vector<const InferenceRegions*>& regions,
+                   std::vector<std::chrono::steady_clock::time_point>& captured);
+};
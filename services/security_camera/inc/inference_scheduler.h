@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "latency_histogram.h"
+
+struct SchedulerConfig {
+    // Cores inference may keep busy on average, 0 for no limit. Capture, motion
+    // detection and streaming are not counted against it.
+    double cpu_budget{1.0};
+    // Detections per second per camera while motion or tracks are active, and while idle
+    double active_fps{5.0};
+    double idle_fps{0.2};
+};
+
+// Picks which captured frames are inferred. The measured cost of a frame
+// turns the CPU budget into a total detection rate, which is shared so every
+// camera keeps its idle cadence and active cameras get the rest, up to
+// active_fps. Shared by the capture threads and the inference workers.
+class InferenceScheduler {
+public:
+    InferenceScheduler(const SchedulerConfig& config, size_t num_cameras, int num_workers);
+
+    // Once per captured frame, true when this one is due for inference
+    bool ShouldInfer(size_t camera, bool active, std::chrono::steady_clock::time_point now);
+    // After each batch with its wall-clock time and the CPU time spent on it
+    void RecordBatch(size_t frames, double wall_ms, double cpu_ms);
+
+    // Detections per second currently granted to a camera
+    double Rate(size_t camera) const;
+    // {"cpu_budget", "cpu_ms_per_frame", "wall_ms_per_frame", "capacity_fps",
+    //  "expected_cpu", "batch_latency": histogram, "cameras": [{"active", "rate_fps", "inferred", "skipped"}]}
+    nlohmann::json Metrics() const;
+
+    // CPU time used by the calling thread. Other workers and the capture, stream
+    // and clip threads are not part of it, the budget only covers inference.
+    static double ThreadCpuMs();
+    // CPU time used by the whole process, includes OpenCV's worker threads
+    static double ProcessCpuMs();
+
+    InferenceScheduler(const InferenceScheduler&) = delete;
+    InferenceScheduler& operator=(const InferenceScheduler&) = delete;
+
+private:
+    // Weight of the newest batch in the per-frame cost averages
+    static constexpr double COST_ALPHA = 0.2;
+    // Keep the workers from running flat out, a full queue only adds latency
+    static constexpr double WORKER_HEADROOM = 0.9;
+
+    struct CameraSchedule {
+        bool active{false};
+        double rate{0.0};
+        std::chrono::steady_clock::time_point next_due{};
+        uint64_t inferred{0};
+        uint64_t skipped{0};
+    };
+
+    SchedulerConfig config_;
+    int num_workers_;
+
+    mutable std::mutex mutex_;
+    std::vector<CameraSchedule> cameras_;
+    // Zero until the first batch, the configured rates apply unchanged until then
+    double cpu_ms_per_frame_{0.0};
+    double wall_ms_per_frame_{0.0};
+    double capacity_fps_{0.0};
+    LatencyHistogram batch_latency_;
+
+    // Share the affordable rate between cameras, caller holds mutex_
+    void Allocate();
+};
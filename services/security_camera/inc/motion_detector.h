@@ -0,0 +1,50 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <vector>
+
+#include "regions.h"
+
+struct MotionResult {
+    bool motion{false};
+    // Fraction of the watched area that changed
+    double score{0.0};
+};
+
+// Cheap motion check run ahead of the DNN. Frames are downscaled to a small
+// grayscale image and compared against a running-average background; only
+// pixels inside the configured regions count towards the score.
+class MotionDetector {
+public:
+    // threshold is the fraction of watched pixels that must change
+    explicit MotionDetector(double threshold = 0.01, int width = 160,
+                            const std::vector<Region>& regions = {});
+    ~MotionDetector() = default;
+
+    MotionResult Detect(const cv::Mat& frame);
+    void Reset();
+
+    void SetThreshold(double threshold);
+    double GetThreshold() const;
+
+private:
+    // Per-pixel intensity change that counts as changed
+    static constexpr double PIXEL_THRESHOLD = 25.0;
+    // How quickly the background adapts to lighting changes
+    static constexpr double BACKGROUND_RATE = 0.05;
+
+    std::atomic<double> threshold_;
+    int width_;
+    std::vector<Region> regions_;
+
+    cv::Mat mask_;
+    int mask_pixels_{0};
+    cv::Mat background_;
+
+    // Reused per-frame buffers
+    cv::Mat small_;
+    cv::Mat gray_;
+    cv::Mat background_u8_;
+    cv::Mat diff_;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "detector_model.h"
+
+struct TrackerConfig {
+    // Overlap a detection needs with a track of the same class to continue it
+    float iou_threshold{0.3f};
+    // Detections in a row before a track is reported, filters single-frame false positives
+    int min_hits{2};
+    // A track exits after this long without a matching detection...
+    int max_age_ms{3000};
+    // ...and no sooner than this many scheduled inferences (plus one for latency),
+    // so tracks survive the gaps between frames at low detection rates
+    int max_missed{2};
+    // A track whose new box overlaps its previous one less than this has moved...
+    float moving_iou{0.9f};
+    // ...and keeps the camera at the active detection rate this long afterwards
+    int moving_hold_ms{2000};
+    // Most frequent update events for a track that is still present
+    int update_interval_ms{5000};
+    // Most frequent snapshots per track
+    int snapshot_interval_ms{10000};
+};
+
+enum class TrackEventType {
+    ENTER,
+    UPDATE,
+    EXIT
+};
+
+struct TrackEvent {
+    TrackEventType type;
+    uint64_t track_id;
+    std::string class_name;
+    float confidence;
+    cv::Rect box;
+    double duration_s;
+
+    nlohmann::json ToJson() const;
+};
+
+// Best frame of a track since its last snapshot
+struct TrackSnapshot {
+    uint64_t track_id;
+    std::string class_name;
+    float confidence;
+    cv::Mat frame;
+};
+
+struct TrackerOutput {
+    std::vector<TrackEvent> events;
+    std::vector<TrackSnapshot> snapshots;
+    // The frame was older than the last one tracked and was ignored
+    bool stale{false};
+};
+
+// Turns per-frame detections into object lifetimes. Detections are matched to
+// tracks of the same class by greedy IoU, so one person standing in view is one
+// enter, a rate-limited stream of updates and one exit rather than a message
+// per inferred frame. Each track keeps only the highest-confidence frame seen
+// since its last snapshot.
+class ObjectTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ObjectTracker(const TrackerConfig& config = TrackerConfig());
+
+    // Feed one inferred frame, empty detections included, with its capture time.
+    // Frames older than the last one fed are ignored. The frame is kept by
+    // reference count when it becomes a track's best frame, it must not be reused.
+    TrackerOutput Update(const std::vector<Detection>& detections, const cv::Mat& frame,
+                         Clock::time_point now = Clock::now());
+    // Exit tracks that have gone stale. Called periodically since no frames are
+    // inferred while the motion gate is closed.
+    TrackerOutput Expire(Clock::time_point now = Clock::now());
+
+    // Time between inferences the scheduler currently grants, zero when none are
+    // scheduled. Stretches the exit age at low detection rates.
+    void SetInferenceInterval(Clock::duration interval);
+
+    size_t ActiveTracks() const;
+    // Confirmed tracks that moved within moving_hold_ms, an object standing
+    // still doesn't count
+    size_t MovingTracks(Clock::time_point now = Clock::now()) const;
+
+private:
+    struct Track {
+        uint64_t id;
+        int class_id;
+        std::string class_name;
+        cv::Rect box;
+        float confidence;
+        int hits{0};
+        bool confirmed{false};
+        Clock::time_point first_seen;
+        Clock::time_point last_seen;
+        Clock::time_point last_moved;
+        Clock::time_point last_event;
+        Clock::time_point last_snapshot;
+        bool snapshotted{false};
+        float snapshot_confidence{0.0f};
+        // Best frame since the last snapshot, empty once it has been sent
+        cv::Mat best_frame;
+        float best_confidence{0.0f};
+    };
+
+    TrackerConfig config_;
+    mutable std::mutex mutex_;
+    std::vector<Track> tracks_;
+    uint64_t next_id_{1};
+    Clock::duration inference_interval_{0};
+    Clock::time_point last_update_{};
+
+    static float IoU(const cv::Rect& a, const cv::Rect& b);
+    TrackEvent MakeEvent(TrackEventType type, const Track& track, Clock::time_point now) const;
+    void TakeSnapshot(Track& track, Clock::time_point now, TrackerOutput& output);
+    // Caller holds mutex_
+    void ExpireLocked(Clock::time_point now, TrackerOutput& output);
+};
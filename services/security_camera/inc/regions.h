@@ -0,0 +1,30 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// A polygon in normalized [0, 1] frame coordinates
+using Region = std::vector<cv::Point2f>;
+
+// Parse regions from "x,y x,y x,y;x,y x,y x,y" - polygons separated by ';',
+// points by whitespace. Invalid polygons (fewer than 3 points) are skipped.
+std::vector<Region> ParseRegions(const std::string& spec);
+
+// Polygon in pixel coordinates for a frame of the given size
+std::vector<cv::Point> RegionToPixels(const Region& region, const cv::Size& size);
+
+// CV_8UC1 mask of the given size with the regions filled with 255.
+// With no regions the whole frame is selected.
+cv::Mat RegionMask(const std::vector<Region>& regions, const cv::Size& size);
+
+// Pixel bounding box of a region, clipped to the frame
+cv::Rect RegionBounds(const Region& region, const cv::Size& size);
+
+// True when point lies inside or on the edge of any region. With no regions
+// the whole frame is selected.
+bool RegionsContain(const std::vector<Region>& regions, const cv::Size& size, const cv::Point& point);
+
+// Cover area with tiles of tile size overlapping by the given fraction. When that
+// takes more than max_tiles the tiles are grown until it does not.
+std::vector<cv::Rect> TileArea(const cv::Rect& area, cv::Size tile, float overlap, int max_tiles);
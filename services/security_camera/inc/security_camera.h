@@ -14,9 +14,11 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <ctime>
+#include <chrono>
 
-#include "camera_capture.h"
-#include "frame_processor.h"
+#include "camera_pipeline.h"
+#include "inference_pool.h"
+#include "stream_server.h"
 #include "paho_mqtt_client.h"
 #include "service_interface.h"
 
@@ -47,8 +49,12 @@ private:
     static constexpr const char* COMMAND_TOPIC = "home/services/security_camera/command";
     static constexpr const char* DETECTIONS_TOPIC = "home/services/security_camera/detections";
     static constexpr const char* SNAPSHOT_TOPIC = "home/services/security_camera/snapshot";
+    // Raw JPEG snapshots in binary mode, followed by the camera id
+    static constexpr const char* SNAPSHOT_IMAGE_TOPIC_PREFIX = "home/services/security_camera/snapshot/jpeg/";
     static constexpr const char* STREAM_TOPIC = "home/services/security_camera/stream";
     static constexpr const char* TOKEN_TOPIC = "home/services/security_camera/token";
+    static constexpr const char* MOTION_TOPIC = "home/services/security_camera/motion";
+    static constexpr const char* CLIPS_TOPIC = "home/services/security_camera/clips";
 
     // State
     std::atomic<bool> running_{true};
@@ -58,6 +64,12 @@ private:
     std::string cert_file_;
     std::string key_file_;
     bool use_https_{true};
+    // SNAPSHOT_MODE=binary publishes the JPEG as is with a metadata message on
+    // SNAPSHOT_TOPIC, json (default) embeds it base64 encoded
+    bool binary_snapshots_{false};
+    std::atomic<uint64_t> snapshot_sequence_{0};
+    // Publish every inferred frame's detections instead of only tracker events
+    bool publish_raw_detections_{false};
     
     // SSL context
     SSL_CTX* ssl_ctx_{nullptr};
@@ -67,34 +79,19 @@ private:
     std::mutex command_queue_mutex_;
     std::condition_variable command_queue_cv_;
 
-    // Camera components
-    std::unique_ptr<CameraCapture> camera_capture_;
-    std::unique_ptr<FrameProcessor> frame_processor_;
-    std::queue<cv::Mat> frame_queue_;
-    std::mutex frame_queue_mutex_;
-    std::condition_variable frame_queue_cv_;
+    // One shared detector, and a capture pipeline per camera feeding it
+    std::unique_ptr<InferencePool> inference_pool_;
+    std::vector<std::unique_ptr<CameraPipeline>> cameras_;
     
-    // Latest frame for streaming
-    cv::Mat latest_frame_;
-    std::mutex latest_frame_mutex_;
-    
-    // Streaming clients
-    struct ClientInfo {
-        int socket;
-        SSL* ssl;
-    };
-    std::vector<ClientInfo> stream_clients_;
-    std::mutex stream_clients_mutex_;
+    // Serves every camera's broadcast frames to stream clients
+    std::unique_ptr<StreamServer> stream_server_;
     
     // Token authentication
     std::map<std::string, time_t> valid_tokens_;
     std::mutex tokens_mutex_;
     
     // Threads
-    std::thread capture_thread_;
-    std::thread processing_thread_;
     std::thread worker_thread_;
-    std::thread stream_server_thread_;
 
     // Thread management and IService interface implementation
     void Run() override;
@@ -102,35 +99,38 @@ private:
     // MQTT handling
     void IncomingMessage(const std::string& topic, const std::string& payload);
     void PublishStatus(const std::string& status);
-    void PublishSnapshot(const cv::Mat& frame);
+    // extra is merged into the snapshot metadata, e.g. the track it shows
+    void PublishSnapshot(const cv::Mat& frame, const std::string& camera, const json& extra = json::object());
     void PublishStreamInfo(bool streaming, const std::string& url = "");
     void PublishToken(const std::string& token);
+    void PublishMotion(const std::string& camera, bool motion, double score);
 
-    // Processing loops
-    void CaptureLoop();
-    void ProcessingLoop();
+    // Processing
+    void HandleDetections(size_t camera, const cv::Mat& frame, const DetectionResult& result);
+    // Detections message when tracks changed (result is null for expiry) and track snapshots
+    void PublishTrackerOutput(size_t camera, const TrackerOutput& output, const DetectionResult* result);
     void ProcessCommand(const json& command);
-    void StreamServerLoop();
+    // Cameras a command applies to, all of them unless it names one
+    std::vector<CameraPipeline*> SelectCameras(const json& command);
 
     // Streaming methods
     bool StartStreaming();
     void StopStreaming();
-    void HandleStreamClient(int client_socket);
-    void SendMJPEGFrame(SSL* ssl, int client_socket, const cv::Mat& frame);
     
     // Token authentication
     std::string GenerateToken();
     bool ValidateToken(const std::string& token);
     void CleanupExpiredTokens();
-    bool ParseHttpRequest(const std::string& request, std::map<std::string, std::string>& headers, std::string& path);
 
     // SSL/TLS methods
     bool InitializeSSL();
     void CleanupSSL();
 
     // Helper methods
+    bool EncodeJpeg(const cv::Mat& image, std::vector<uchar>& buffer);
     std::string MatToBase64(const cv::Mat& image);
     bool GetEnvVar(const std::string& name, std::string& value);
     bool GetEnvVar(const std::string& name, int& value);
     bool GetEnvVar(const std::string& name, bool& value);
+    bool GetEnvVar(const std::string& name, double& value);
 }; 
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/uio.h>
+#include <openssl/ssl.h>
+
+#include "frame_broadcaster.h"
+
+// A camera viewers can select with the camera query parameter
+struct StreamSource {
+    std::string camera;
+    FrameBroadcaster* broadcaster{nullptr};
+};
+
+// Event-driven MJPEG server. A small fixed set of epoll reactors handles
+// accepts, TLS handshakes, HTTP parsing and frame writes on non-blocking
+// sockets; each client has its own write queue of shared encoded frames.
+class StreamServer {
+public:
+    using TokenValidator = std::function<bool(const std::string&)>;
+
+    // ssl_ctx may be null to serve plain HTTP. Requests without a camera
+    // parameter get the first source.
+    StreamServer(std::vector<StreamSource> sources, SSL_CTX* ssl_ctx,
+                 TokenValidator validate_token, int num_threads = 2);
+    ~StreamServer();
+
+    bool Start(int port);
+    void Stop();
+    bool IsRunning() const;
+
+    // Wake the reactors so streaming clients get the latest frame of their camera
+    void NotifyFrame();
+    size_t ClientCount() const;
+
+    static bool ParseHttpRequest(const std::string& request, std::map<std::string, std::string>& headers,
+                                 std::string& path);
+    static std::string QueryParameter(const std::string& path, const std::string& name);
+
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+
+private:
+    // Frames queued per client beyond which new frames are skipped
+    static constexpr size_t MAX_QUEUED_FRAMES = 2;
+    static constexpr size_t MAX_REQUEST_SIZE = 8192;
+
+    enum class ClientState {
+        HANDSHAKE,
+        READ_REQUEST,
+        STREAMING,
+        CLOSING
+    };
+
+    // Either a shared frame (header + JPEG + trailer) or an owned text response
+    struct OutChunk {
+        EncodedFramePtr frame;
+        std::string text;
+        size_t offset{0};
+        // Set on the first write attempt. A TLS write that returned WANT_WRITE
+        // must be retried with the same bytes, so the chunk is pinned from then on.
+        bool write_started{false};
+    };
+
+    struct Client {
+        int socket{-1};
+        SSL* ssl{nullptr};
+        ClientState state{ClientState::HANDSHAKE};
+        uint32_t events{0};
+        bool ssl_want_write{false};
+        std::string peer;
+        std::string request;
+        std::deque<OutChunk> write_queue;
+        size_t queued_frames{0};
+        uint64_t last_sequence{0};
+        size_t source{0};
+    };
+
+    struct Reactor {
+        int epoll_fd{-1};
+        int wake_fd{-1};
+        std::thread thread;
+        std::unordered_map<int, std::unique_ptr<Client>> clients;
+
+        ~Reactor();
+    };
+
+    std::vector<StreamSource> sources_;
+    SSL_CTX* ssl_ctx_;
+    TokenValidator validate_token_;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    int listen_fd_{-1};
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> client_count_{0};
+
+    void ReactorLoop(Reactor* reactor);
+    void AcceptClients(Reactor& reactor);
+    void HandleClientEvent(Reactor& reactor, int fd, uint32_t events);
+    void QueueLatestFrame(Reactor& reactor);
+    void CloseClient(Reactor& reactor, int fd);
+    bool UpdateInterest(Reactor& reactor, Client& client);
+
+    // Per-client protocol steps; returning false closes the connection
+    bool ContinueHandshake(Client& client);
+    bool ReadRequest(Client& client);
+    bool HandleRequest(Client& client);
+    bool DrainInput(Client& client);
+    bool FlushWrites(Client& client);
+
+    void QueueText(Client& client, const std::string& text);
+    void QueueFrame(Client& client, const EncodedFramePtr& frame);
+    ssize_t ReadSome(Client& client, char* buffer, size_t size);
+    ssize_t WriteChunk(Client& client, const OutChunk& chunk);
+    static size_t ChunkSize(const OutChunk& chunk);
+    static int ChunkSegments(const OutChunk& chunk, iovec* iov);
+};
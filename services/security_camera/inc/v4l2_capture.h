@@ -0,0 +1,74 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Native V4L2 streaming capture. The driver fills a ring of buffers that are
+// mmap'd into our address space, and frames are exposed as views over that
+// memory without copying. A view stays valid until the next Grab() hands the
+// buffer back to the driver.
+class V4L2Capture {
+public:
+    enum class PixelFormat {
+        YUYV,
+        MJPEG
+    };
+
+    V4L2Capture(const std::string& device, int width, int height, int fps,
+                PixelFormat format = PixelFormat::YUYV, unsigned int buffer_count = 4);
+    ~V4L2Capture();
+
+    bool Open();
+    void Close();
+    bool IsOpened() const;
+
+    // Dequeue the next filled buffer, waiting up to timeout_ms.
+    // The previously held buffer is requeued first.
+    bool Grab(int timeout_ms = 1000);
+
+    // View of the held buffer: YUYV frames are a CV_8UC2 height x width Mat,
+    // MJPEG frames a 1 x N CV_8UC1 row of the compressed bytes
+    cv::Mat View() const;
+    const uint8_t* Data() const;
+    size_t Size() const;
+
+    PixelFormat Format() const;
+    int Width() const;
+    int Height() const;
+    int FPS() const;
+
+    V4L2Capture(const V4L2Capture&) = delete;
+    V4L2Capture& operator=(const V4L2Capture&) = delete;
+
+private:
+    struct MappedBuffer {
+        void* start{nullptr};
+        size_t length{0};
+    };
+
+    std::string device_;
+    int width_;
+    int height_;
+    int fps_;
+    PixelFormat format_;
+    unsigned int buffer_count_;
+
+    int fd_{-1};
+    bool streaming_{false};
+    std::vector<MappedBuffer> buffers_;
+    int held_index_{-1};
+    size_t held_bytes_{0};
+    // Buffers the driver has not got back yet, retried on every Grab
+    std::vector<int> unqueued_;
+    size_t bytes_per_line_{0};
+
+    bool Ioctl(unsigned long request, void* arg) const;
+    bool ConfigureFormat();
+    void ConfigureFrameRate();
+    bool MapBuffers();
+    void UnmapBuffers();
+    bool Requeue(int index);
+};
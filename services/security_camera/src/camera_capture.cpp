@@ -1,9 +1,11 @@
 #include "camera_capture.h"
 #include "log.h"
 #include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
 
-CameraCapture::CameraCapture(int camera_id, int width, int height, int fps)
-    : camera_id_(camera_id), width_(width), height_(height), fps_(fps) {
+CameraCapture::CameraCapture(int camera_id, int width, int height, int fps, CaptureBackend backend, bool mjpeg,
+                             const std::string& source)
+    : backend_(backend), mjpeg_(mjpeg), source_spec_(source), camera_id_(camera_id), width_(width), height_(height), fps_(fps) {
 }
 
 CameraCapture::~CameraCapture() {
@@ -15,6 +17,38 @@ CameraCapture::~CameraCapture() {
 bool CameraCapture::Initialize() {
     INFO_LOG("Initializing camera with ID: " + std::to_string(camera_id_));
     
+    if (backend_ == CaptureBackend::SOURCE) {
+        source_ = std::make_unique<FrameSource>(source_spec_, width_, height_, fps_);
+        if (!source_->Open()) {
+            ERROR_LOG("Failed to open frame source for camera ID: " + std::to_string(camera_id_));
+            source_.reset();
+            return false;
+        }
+        
+        width_ = source_->Width();
+        height_ = source_->Height();
+        fps_ = source_->FPS();
+        INFO_LOG("Camera initialized successfully");
+        return true;
+    }
+    
+    if (backend_ == CaptureBackend::V4L2) {
+        v4l2_ = std::make_unique<V4L2Capture>(
+            "/dev/video" + std::to_string(camera_id_), width_, height_, fps_,
+            mjpeg_ ? V4L2Capture::PixelFormat::MJPEG : V4L2Capture::PixelFormat::YUYV);
+        if (!v4l2_->Open()) {
+            ERROR_LOG("Failed to open V4L2 camera with ID: " + std::to_string(camera_id_));
+            v4l2_.reset();
+            return false;
+        }
+        
+        width_ = v4l2_->Width();
+        height_ = v4l2_->Height();
+        fps_ = v4l2_->FPS();
+        INFO_LOG("Camera initialized successfully");
+        return true;
+    }
+    
     // Open camera
     cap_.open(camera_id_);
     if (!cap_.isOpened()) {
@@ -31,15 +65,44 @@ bool CameraCapture::Initialize() {
 }
 
 cv::Mat CameraCapture::CaptureFrame() {
-    cv::Mat frame;
-    
-    if (!cap_.isOpened()) {
+    if (!GrabFrame()) {
+        return cv::Mat();
+    }
+    return RetrieveFrame();
+}
+
+bool CameraCapture::GrabFrame() {
+    if (!IsOpened()) {
         ERROR_LOG("Camera is not opened");
-        return frame;
+        return false;
+    }
+    if (source_) {
+        return source_->Grab();
     }
+    if (v4l2_) {
+        return v4l2_->Grab();
+    }
+    return cap_.grab();
+}
+
+cv::Mat CameraCapture::RetrieveFrame() {
+    cv::Mat frame;
     
-    // Capture frame
-    cap_ >> frame;
+    if (source_) {
+        frame = source_->Retrieve();
+    } else if (v4l2_) {
+        // Decode straight out of the mapped driver buffer into the output frame
+        cv::Mat view = v4l2_->View();
+        if (!view.empty()) {
+            if (v4l2_->Format() == V4L2Capture::PixelFormat::MJPEG) {
+                frame = cv::imdecode(view, cv::IMREAD_COLOR);
+            } else {
+                cv::cvtColor(view, frame, cv::COLOR_YUV2BGR_YUYV);
+            }
+        }
+    } else {
+        cap_.retrieve(frame);
+    }
     
     if (frame.empty()) {
         WARN_LOG("Empty frame captured");
@@ -55,9 +118,28 @@ cv::Mat CameraCapture::CaptureFrame() {
 }
 
 bool CameraCapture::IsOpened() const {
+    if (source_) {
+        return source_->IsOpened();
+    }
+    if (v4l2_) {
+        return v4l2_->IsOpened();
+    }
     return cap_.isOpened();
 }
 
+bool CameraCapture::GetEncodedFrame(const uint8_t*& data, size_t& size) const {
+    // Night mode alters the image, so the device's JPEG can't be passed through
+    if (source_ && !night_mode_) {
+        return source_->GetEncoded(data, size);
+    }
+    if (!v4l2_ || v4l2_->Format() != V4L2Capture::PixelFormat::MJPEG || night_mode_) {
+        return false;
+    }
+    data = v4l2_->Data();
+    size = v4l2_->Size();
+    return data != nullptr && size > 0;
+}
+
 void CameraCapture::SetNightMode(bool enabled) {
     night_mode_ = enabled;
 }
@@ -119,7 +201,8 @@ void CameraCapture::SetFPS(int fps) {
     // Verify that the FPS was set correctly
     double actual_fps = cap_.get(cv::CAP_PROP_FPS);
     
-    if (actual_fps != fps_) {
+    // Some drivers report 0 when the rate can't be queried, keep the requested rate then
+    if (actual_fps > 0 && actual_fps != fps_) {
         WARN_LOG("Requested FPS (" + std::to_string(fps_) + ") not supported. Using " + 
                 std::to_string(static_cast<int>(actual_fps)) + " instead.");
         
@@ -127,6 +210,18 @@ void CameraCapture::SetFPS(int fps) {
     }
 }
 
+int CameraCapture::GetFPS() const {
+    return fps_;
+}
+
+int CameraCapture::GetWidth() const {
+    return width_;
+}
+
+int CameraCapture::GetHeight() const {
+    return height_;
+}
+
 cv::Mat CameraCapture::EnhanceNightVision(const cv::Mat& frame) const {
     if (frame.empty()) {
         return frame;
@@ -0,0 +1,200 @@
+#include "camera_pipeline.h"
+#include "log.h"
+#include <algorithm>
+
+CameraPipeline::CameraPipeline(size_t index, const CameraConfig& config, InferencePool& inference_pool,
+                               FrameCallback on_broadcast, MotionCallback on_motion,
+                               ClipRecorder::ClipCallback on_clip)
+    : index_(index),
+      config_(config),
+      inference_pool_(inference_pool),
+      on_broadcast_(std::move(on_broadcast)),
+      on_motion_(std::move(on_motion)),
+      tracker_(config.tracker),
+      recorder_(config.id, config.clips, std::move(on_clip)) {
+    camera_capture_ = std::make_unique<CameraCapture>(
+        config_.device, config_.width, config_.height, config_.fps, config_.backend, config_.mjpeg, config_.source);
+    motion_detector_ = std::make_unique<MotionDetector>(config_.motion_threshold, 160, config_.motion_regions);
+    inference_pool_.SetRegions(index_, config_.inference);
+}
+
+CameraPipeline::~CameraPipeline() {
+    Stop();
+}
+
+bool CameraPipeline::Initialize() {
+    if (!camera_capture_->Initialize()) {
+        ERROR_LOG("Failed to initialize camera " + config_.id);
+        return false;
+    }
+    INFO_LOG("Camera " + config_.id + " initialized successfully");
+    return true;
+}
+
+void CameraPipeline::Start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    recorder_.Start();
+    capture_thread_ = std::thread(&CameraPipeline::CaptureLoop, this);
+}
+
+void CameraPipeline::Stop() {
+    running_ = false;
+    if (capture_thread_.joinable()) {
+        capture_thread_.join();
+        DEBUG_LOG("Capture thread for camera " + config_.id + " joined");
+    }
+    recorder_.Stop();
+}
+
+void CameraPipeline::SetStreaming(bool streaming) {
+    streaming_ = streaming;
+    if (!streaming) {
+        frame_broadcaster_.Reset();
+    }
+}
+
+size_t CameraPipeline::Index() const {
+    return index_;
+}
+
+const std::string& CameraPipeline::Id() const {
+    return config_.id;
+}
+
+CameraCapture& CameraPipeline::Capture() {
+    return *camera_capture_;
+}
+
+FrameBroadcaster& CameraPipeline::Broadcaster() {
+    return frame_broadcaster_;
+}
+
+ObjectTracker& CameraPipeline::Tracker() {
+    return tracker_;
+}
+
+std::mutex& CameraPipeline::TrackingMutex() {
+    return tracking_mutex_;
+}
+
+ClipRecorder& CameraPipeline::Recorder() {
+    return recorder_;
+}
+
+cv::Mat CameraPipeline::LatestFrame() const {
+    return frame_channel_.Latest();
+}
+
+bool CameraPipeline::IsMotionActive() const {
+    return motion_active_;
+}
+
+void CameraPipeline::SetMotionThreshold(double threshold) {
+    motion_detector_->SetThreshold(threshold);
+}
+
+void CameraPipeline::CaptureLoop() {
+    INFO_LOG("Capture thread for camera " + config_.id + " started");
+
+    // The blocking grab paces this loop at the device's real frame timing. If the
+    // device runs faster than FPS_TARGET, surplus frames are grabbed but not decoded.
+    const int fps = std::max(1, camera_capture_->GetFPS());
+    const auto frame_interval = std::chrono::microseconds(1000000 / fps);
+    const auto frame_tolerance = frame_interval / 4;
+    auto next_frame_time = std::chrono::steady_clock::now();
+
+    while (running_) {
+        try {
+            if (!camera_capture_->GrabFrame()) {
+                WARN_LOG("Failed to grab frame from camera " + config_.id);
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now + frame_tolerance < next_frame_time) {
+                continue;
+            }
+            // Don't build up a backlog if the device is slower than the target
+            next_frame_time = std::max(next_frame_time + frame_interval, now);
+
+            // The clip recorder shares the stream's encoded frames at its own rate
+            const bool streaming = streaming_;
+            const bool record = recorder_.WantsFrame(now);
+
+            // MJPEG cameras: pass the device's JPEG through to viewers untouched
+            EncodedFramePtr encoded;
+            const uint8_t* jpeg = nullptr;
+            size_t jpeg_size = 0;
+            if ((streaming || record) && camera_capture_->GetEncodedFrame(jpeg, jpeg_size)) {
+                encoded = frame_broadcaster_.PublishEncoded(
+                    jpeg, jpeg_size, camera_capture_->GetWidth(), camera_capture_->GetHeight());
+            }
+
+            cv::Mat frame = camera_capture_->RetrieveFrame();
+            if (frame.empty()) {
+                WARN_LOG("Empty frame captured from camera " + config_.id);
+                continue;
+            }
+
+            // Otherwise encode once for all streaming clients and the recorder
+            if ((streaming || record) && !encoded) {
+                encoded = frame_broadcaster_.Publish(frame);
+            }
+            if (encoded && streaming && on_broadcast_) {
+                on_broadcast_();
+            }
+            if (encoded && record) {
+                recorder_.Push(encoded);
+            }
+
+            frame_channel_.Publish(frame);
+
+            // Motion and moving tracked objects raise the detection rate, the scheduler
+            // keeps it inside the CPU budget and lowers it while the scene is static.
+            // A parked car stays tracked at the idle rate.
+            bool active = UpdateMotion(frame) || tracker_.MovingTracks(now) > 0;
+            if (inference_pool_.Scheduler().ShouldInfer(index_, active, now)) {
+                inference_pool_.Submit(index_, frame, now);
+            }
+            double rate = inference_pool_.Scheduler().Rate(index_);
+            tracker_.SetInferenceInterval(rate > 0.0
+                ? std::chrono::duration_cast<ObjectTracker::Clock::duration>(std::chrono::duration<double>(1.0 / rate))
+                : ObjectTracker::Clock::duration::zero());
+        } catch (const std::exception& e) {
+            ERROR_LOG("Error in capture loop for camera " + config_.id + ": " + std::string(e.what()));
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+
+    INFO_LOG("Capture thread for camera " + config_.id + " stopped");
+}
+
+bool CameraPipeline::UpdateMotion(const cv::Mat& frame) {
+    if (!config_.motion_enabled) {
+        return true;
+    }
+
+    MotionResult motion = motion_detector_->Detect(frame);
+    auto now = std::chrono::steady_clock::now();
+    if (motion.motion) {
+        last_motion_time_ = now;
+        if (!motion_active_) {
+            motion_active_ = true;
+            if (on_motion_) {
+                on_motion_(index_, true, motion.score);
+            }
+        }
+    } else if (motion_active_ && now - last_motion_time_ >= std::chrono::milliseconds(config_.motion_hold_ms)) {
+        // Keep inferring for a moment after motion stops so still objects are still reported
+        motion_active_ = false;
+        if (on_motion_) {
+            on_motion_(index_, false, motion.score);
+        }
+    }
+
+    return motion_active_;
+}
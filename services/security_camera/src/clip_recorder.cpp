@@ -0,0 +1,317 @@
+#include "clip_recorder.h"
+#include "log.h"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+ClipRecorder::ClipRecorder(const std::string& camera, const ClipConfig& config, ClipCallback on_clip)
+    : camera_(camera), config_(config), on_clip_(std::move(on_clip)) {
+    config_.fps = std::max(1, config_.fps);
+}
+
+ClipRecorder::~ClipRecorder() {
+    Stop();
+}
+
+void ClipRecorder::Start() {
+    if (!config_.enabled || writer_thread_.joinable()) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(config_.directory, error);
+    if (error) {
+        ERROR_LOG("Cannot create clip directory " + config_.directory + ": " + error.message());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    writer_thread_ = std::thread(&ClipRecorder::WriterLoop, this);
+    INFO_LOG("Clip recording for camera " + camera_ + " to " + config_.directory + ", " +
+             std::to_string(config_.pre_event_s) + "s before and " + std::to_string(config_.post_event_s) +
+             "s after events at " + std::to_string(config_.fps) + " fps");
+}
+
+void ClipRecorder::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        // Close out the running clip, the writer drains everything before exiting
+        if (recording_) {
+            FinishClip();
+        }
+        running_ = false;
+    }
+    writer_cv_.notify_one();
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+}
+
+bool ClipRecorder::Enabled() const {
+    return config_.enabled;
+}
+
+bool ClipRecorder::WantsFrame(Clock::time_point now) {
+    if (!config_.enabled) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now < next_frame_time_) {
+        return false;
+    }
+    const auto interval = std::chrono::microseconds(1000000 / config_.fps);
+    next_frame_time_ = std::max(next_frame_time_ + interval, now);
+    return true;
+}
+
+void ClipRecorder::Push(const EncodedFramePtr& frame) {
+    if (!frame || !config_.enabled) {
+        return;
+    }
+
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+
+        if (recording_) {
+            const auto now = frame->timestamp;
+            if (now - clip_.last_trigger >= std::chrono::seconds(config_.post_event_s) ||
+                now - clip_.first_frame >= std::chrono::seconds(config_.max_clip_s)) {
+                FinishClip();
+                notify = true;
+            } else {
+                QueueFrame(frame);
+                notify = pending_bytes_ >= config_.write_batch_bytes;
+            }
+        }
+
+        if (!recording_) {
+            ring_.push_back(frame);
+            ring_bytes_ += frame->jpeg.size();
+            TrimRing(frame->timestamp);
+        }
+    }
+    if (notify) {
+        writer_cv_.notify_one();
+    }
+}
+
+void ClipRecorder::Trigger(const nlohmann::json& reason) {
+    if (!config_.enabled) {
+        return;
+    }
+
+    nlohmann::json started;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        const auto now = Clock::now();
+        if (recording_) {
+            clip_.last_trigger = now;
+            return;
+        }
+        StartClip(now, reason);
+        started = ClipJson(clip_, "recording");
+    }
+    if (on_clip_) {
+        on_clip_(started);
+    }
+}
+
+void ClipRecorder::Extend() {
+    if (!config_.enabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (recording_) {
+        clip_.last_trigger = Clock::now();
+    }
+}
+
+void ClipRecorder::StartClip(Clock::time_point now, const nlohmann::json& reason) {
+    // A new clip starts with the pre-event ring
+    recording_ = true;
+    clip_ = Clip();
+    clip_.id = next_clip_id_++;
+    clip_.started = std::time(nullptr);
+    clip_.last_trigger = now;
+    clip_.trigger = reason;
+    clip_.first_frame = ring_.empty() ? now : ring_.front()->timestamp;
+    clip_.last_frame = clip_.first_frame;
+
+    std::tm local{};
+    localtime_r(&clip_.started, &local);
+    std::ostringstream path;
+    path << config_.directory << "/" << camera_ << "_" << std::put_time(&local, "%Y%m%d_%H%M%S")
+         << "_" << clip_.id << ".mjpeg";
+    clip_.path = path.str();
+
+    for (auto& frame : ring_) {
+        QueueFrame(frame);
+    }
+    clip_.pre_event_frames = clip_.frames;
+    ring_.clear();
+    ring_bytes_ = 0;
+
+    INFO_LOG("Recording clip " + clip_.path + " with " + std::to_string(clip_.pre_event_frames) + " pre-event frames");
+}
+
+bool ClipRecorder::Recording() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return recording_;
+}
+
+nlohmann::json ClipRecorder::Metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {
+        {"recording", recording_},
+        {"ring_frames", ring_.size()},
+        {"ring_bytes", ring_bytes_},
+        {"pending_bytes", pending_bytes_},
+        {"clips", clips_},
+        {"dropped_frames", dropped_}
+    };
+}
+
+void ClipRecorder::TrimRing(Clock::time_point now) {
+    const auto window = std::chrono::seconds(config_.pre_event_s);
+    while (!ring_.empty() &&
+           (now - ring_.front()->timestamp > window || ring_bytes_ + pending_bytes_ > config_.memory_budget_bytes)) {
+        ring_bytes_ -= ring_.front()->jpeg.size();
+        ring_.pop_front();
+    }
+}
+
+void ClipRecorder::QueueFrame(const EncodedFramePtr& frame) {
+    if (pending_bytes_ + frame->jpeg.size() > config_.memory_budget_bytes) {
+        // The card can't keep up, drop rather than grow
+        clip_.dropped++;
+        dropped_++;
+        return;
+    }
+    pending_.push_back({frame, clip_.path, Clip()});
+    pending_bytes_ += frame->jpeg.size();
+    clip_.frames++;
+    clip_.bytes += frame->jpeg.size();
+    clip_.last_frame = frame->timestamp;
+}
+
+void ClipRecorder::FinishClip() {
+    pending_.push_back({nullptr, clip_.path, clip_});
+    recording_ = false;
+    clips_++;
+}
+
+void ClipRecorder::WriterLoop() {
+    const auto flush_interval = std::chrono::seconds(2);
+    std::deque<WriteItem> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            writer_cv_.wait_for(lock, flush_interval, [this] {
+                return !running_ || pending_bytes_ >= config_.write_batch_bytes ||
+                       (!pending_.empty() && !pending_.back().frame);
+            });
+            if (pending_.empty() && !running_) {
+                break;
+            }
+            batch.swap(pending_);
+        }
+
+        for (const auto& item : batch) {
+            if (item.frame) {
+                WriteFrame(item);
+            } else {
+                CloseClip(item.clip);
+            }
+        }
+        if (file_) {
+            std::fflush(file_);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& item : batch) {
+                if (item.frame) {
+                    pending_bytes_ -= item.frame->jpeg.size();
+                }
+            }
+        }
+        batch.clear();
+    }
+
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool ClipRecorder::WriteFrame(const WriteItem& item) {
+    if (file_path_ != item.path) {
+        if (file_) {
+            std::fclose(file_);
+        }
+        file_path_ = item.path;
+        file_ = std::fopen(file_path_.c_str(), "wb");
+        if (!file_) {
+            ERROR_LOG("Cannot open clip file " + file_path_);
+            return false;
+        }
+        // Large stdio buffer so the card sees big sequential writes
+        std::setvbuf(file_, nullptr, _IOFBF, config_.write_batch_bytes);
+    }
+    if (!file_) {
+        // Opening this clip failed, its frames are dropped
+        return false;
+    }
+    const auto& jpeg = item.frame->jpeg;
+    return std::fwrite(jpeg.data(), 1, jpeg.size(), file_) == jpeg.size();
+}
+
+void ClipRecorder::CloseClip(const Clip& clip) {
+    Clip finished = clip;
+    if (file_ && file_path_ == clip.path) {
+        finished.failed = std::ferror(file_) != 0;
+        std::fclose(file_);
+        file_ = nullptr;
+    } else {
+        finished.failed = finished.frames > 0;
+    }
+
+    INFO_LOG("Clip " + finished.path + " " + (finished.failed ? "failed" : "complete") + ": " +
+             std::to_string(finished.frames) + " frames, " + std::to_string(finished.bytes) + " bytes");
+    if (on_clip_) {
+        on_clip_(ClipJson(finished, finished.failed ? "failed" : "complete"));
+    }
+}
+
+nlohmann::json ClipRecorder::ClipJson(const Clip& clip, const std::string& status) const {
+    return {
+        {"camera", camera_},
+        {"clip_id", clip.id},
+        {"status", status},
+        {"path", clip.path},
+        {"format", "mjpeg"},
+        {"started", clip.started},
+        {"duration_s", std::chrono::duration<double>(clip.last_frame - clip.first_frame).count()},
+        {"frames", clip.frames},
+        {"bytes", clip.bytes},
+        {"pre_event_frames", clip.pre_event_frames},
+        {"dropped_frames", clip.dropped},
+        {"trigger", clip.trigger}
+    };
+}
@@ -0,0 +1,440 @@
+#include "detector_model.h"
+#include "log.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+const std::string MODEL_DIR = "/usr/local/lib/security_camera/";
+
+const std::vector<std::string> COCO_CLASSES = {
+    "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat",
+    "traffic light", "fire hydrant", "stop sign", "parking meter", "bench", "bird", "cat", "dog",
+    "horse", "sheep", "cow", "elephant", "bear", "zebra", "giraffe", "backpack", "umbrella",
+    "handbag", "tie", "suitcase", "frisbee", "skis", "snowboard", "sports ball", "kite",
+    "baseball bat", "baseball glove", "skateboard", "surfboard", "tennis racket", "bottle",
+    "wine glass", "cup", "fork", "knife", "spoon", "bowl", "banana", "apple", "sandwich", "orange",
+    "broccoli", "carrot", "hot dog", "pizza", "donut", "cake", "chair", "couch", "potted plant",
+    "bed", "dining table", "toilet", "tv", "laptop", "mouse", "remote", "keyboard", "cell phone",
+    "microwave", "oven", "toaster", "sink", "refrigerator", "book", "clock", "vase", "scissors",
+    "teddy bear", "hair drier", "toothbrush"
+};
+
+// PASCAL VOC labels used by MobileNet-SSD, named like their COCO counterparts
+const std::vector<std::string> VOC_CLASSES = {
+    "background", "airplane", "bicycle", "bird", "boat", "bottle", "bus", "car", "cat", "chair",
+    "cow", "dining table", "dog", "horse", "motorcycle", "person", "potted plant", "sheep",
+    "couch", "train", "tv"
+};
+
+// Index of the highest score in a contiguous row
+int ArgMax(const float* scores, int count, float& best) {
+    if (count <= 0) {
+        best = 0.0f;
+        return -1;
+    }
+
+    int i = 0;
+    best = scores[0];
+#if CV_SIMD
+    const int lanes = cv::v_float32::nlanes;
+    if (count >= lanes) {
+        cv::v_float32 vmax = cv::vx_load(scores);
+        for (i = lanes; i <= count - lanes; i += lanes) {
+            vmax = cv::v_max(vmax, cv::vx_load(scores + i));
+        }
+        best = cv::v_reduce_max(vmax);
+    }
+#endif
+    for (; i < count; ++i) {
+        best = std::max(best, scores[i]);
+    }
+    return static_cast<int>(std::find(scores, scores + count, best) - scores);
+}
+
+// Per-candidate best class over a [classes, count] planar score block, as
+// produced by YOLOv8. Scanning class planes keeps every load contiguous.
+void ArgMaxColumns(const float* scores, int classes, int count,
+                   std::vector<float>& best, std::vector<int>& best_class) {
+    best.assign(scores, scores + count);
+    best_class.assign(count, 0);
+
+    for (int c = 1; c < classes; ++c) {
+        const float* plane = scores + static_cast<size_t>(c) * count;
+        int i = 0;
+#if CV_SIMD
+        const int lanes = cv::v_float32::nlanes;
+        const cv::v_int32 vclass = cv::vx_setall_s32(c);
+        for (; i <= count - lanes; i += lanes) {
+            cv::v_float32 vscore = cv::vx_load(plane + i);
+            cv::v_float32 vbest = cv::vx_load(best.data() + i);
+            cv::v_float32 mask = vscore > vbest;
+            cv::v_store(best.data() + i, cv::v_select(mask, vscore, vbest));
+            cv::v_int32 vidx = cv::vx_load(best_class.data() + i);
+            cv::v_store(best_class.data() + i, cv::v_select(cv::v_reinterpret_as_s32(mask), vclass, vidx));
+        }
+#endif
+        for (; i < count; ++i) {
+            if (plane[i] > best[i]) {
+                best[i] = plane[i];
+                best_class[i] = c;
+            }
+        }
+    }
+}
+
+// Rows of one image in a batched region output. Depending on the OpenCV
+// version images are stacked along a leading dimension or their rows are
+// concatenated.
+cv::Mat BatchSlice(const cv::Mat& out, int batch_index, int batch_size) {
+    if (out.dims == 3) {
+        return cv::Mat(out.size[1], out.size[2], CV_32F, const_cast<float*>(out.ptr<float>(batch_index)));
+    }
+    if (batch_size <= 1) {
+        return out;
+    }
+    const int rows = out.rows / batch_size;
+    return out.rowRange(batch_index * rows, (batch_index + 1) * rows);
+}
+
+}
+
+void DetectionCandidates::Add(const cv::Rect& box, float score, int class_id) {
+    boxes.push_back(box);
+    scores.push_back(score);
+    class_ids.push_back(class_id);
+}
+
+void DetectionCandidates::Clear() {
+    boxes.clear();
+    scores.clear();
+    class_ids.clear();
+}
+
+ModelConfig ModelConfig::FromName(const std::string& name) {
+    ModelConfig config;
+    config.name = name;
+
+    if (name == "yolov3") {
+        return config;
+    }
+    if (name == "yolov4-tiny") {
+        config.type = ModelType::YOLO_DARKNET;
+        config.model_path = MODEL_DIR + "yolov4-tiny.weights";
+        config.config_path = MODEL_DIR + "yolov4-tiny.cfg";
+        config.input_size = cv::Size(416, 416);
+        return config;
+    }
+    if (name == "yolov8n") {
+        config.type = ModelType::YOLOV8_ONNX;
+        config.model_path = MODEL_DIR + "yolov8n.onnx";
+        config.config_path.clear();
+        config.input_size = cv::Size(640, 640);
+        return config;
+    }
+    if (name == "mobilenet-ssd") {
+        config.type = ModelType::SSD_CAFFE;
+        config.model_path = MODEL_DIR + "MobileNetSSD_deploy.caffemodel";
+        config.config_path = MODEL_DIR + "MobileNetSSD_deploy.prototxt";
+        config.input_size = cv::Size(300, 300);
+        return config;
+    }
+
+    WARN_LOG("Unknown detection model '" + name + "', using yolov3");
+    return ModelConfig();
+}
+
+DetectorModel::DetectorModel(const ModelConfig& config)
+    : config_(config) {
+}
+
+std::unique_ptr<DetectorModel> DetectorModel::Create(const ModelConfig& config) {
+    switch (config.type) {
+        case ModelType::YOLOV8_ONNX:
+            return std::make_unique<YoloV8OnnxModel>(config);
+        case ModelType::SSD_CAFFE:
+            return std::make_unique<SsdModel>(config);
+        case ModelType::YOLO_DARKNET:
+        default:
+            return std::make_unique<YoloDarknetModel>(config);
+    }
+}
+
+bool DetectorModel::Load() {
+    INFO_LOG("Loading detection model " + config_.name + " (" + config_.model_path + ") with input " +
+             std::to_string(config_.input_size.width) + "x" + std::to_string(config_.input_size.height));
+
+    net_ = ReadNet();
+    if (net_.empty()) {
+        ERROR_LOG("Failed to load detection model " + config_.name);
+        return false;
+    }
+
+    net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    INFO_LOG("Using CPU backend for inference");
+    output_names_ = net_.getUnconnectedOutLayersNames();
+
+    class_names_ = DefaultClassNames();
+    if (!config_.classes_path.empty()) {
+        std::ifstream file(config_.classes_path);
+        if (!file.good()) {
+            ERROR_LOG("Cannot read class names at: " + config_.classes_path);
+            return false;
+        }
+        class_names_.clear();
+        std::string line;
+        while (std::getline(file, line)) {
+            line.erase(line.find_last_not_of(" \r\n\t") + 1);
+            class_names_.push_back(line);
+        }
+    }
+
+    BuildClassMask();
+    return true;
+}
+
+std::vector<Detection> DetectorModel::Detect(const cv::Mat& frame) {
+    return DetectBatch({frame}).front();
+}
+
+std::vector<std::vector<Detection>> DetectorModel::DetectBatch(const std::vector<cv::Mat>& frames) {
+    std::vector<std::vector<Detection>> results(frames.size());
+    if (frames.empty()) {
+        return results;
+    }
+
+    cv::Mat blob = cv::dnn::blobFromImages(frames, scale_, config_.input_size, mean_, swap_rb_, false);
+    net_.setInput(blob);
+
+    std::vector<cv::Mat> outs;
+    net_.forward(outs, output_names_);
+
+    const int batch_size = static_cast<int>(frames.size());
+    for (int b = 0; b < batch_size; ++b) {
+        candidates_.Clear();
+        Decode(outs, b, batch_size, frames[b].size(), candidates_);
+        results[b] = Suppress(candidates_);
+    }
+    return results;
+}
+
+std::vector<Detection> DetectorModel::Suppress(const DetectionCandidates& candidates) const {
+    std::vector<int> keep;
+    if (apply_nms_) {
+        // Suppress overlaps within each class only, a person next to a car is two objects
+        cv::dnn::NMSBoxesBatched(candidates.boxes, candidates.scores, candidates.class_ids,
+                                 config_.conf_threshold, config_.nms_threshold, keep);
+    } else {
+        keep.resize(candidates.boxes.size());
+        for (size_t i = 0; i < keep.size(); ++i) {
+            keep[i] = static_cast<int>(i);
+        }
+    }
+
+    std::vector<Detection> detections;
+    detections.reserve(keep.size());
+    for (int idx : keep) {
+        Detection det;
+        det.class_id = candidates.class_ids[idx];
+        det.class_name = ClassName(det.class_id);
+        det.confidence = candidates.scores[idx];
+        det.box = candidates.boxes[idx];
+        detections.push_back(std::move(det));
+    }
+    return detections;
+}
+
+const ModelConfig& DetectorModel::Config() const {
+    return config_;
+}
+
+const std::vector<std::string>& DetectorModel::ClassNames() const {
+    return class_names_;
+}
+
+void DetectorModel::BuildClassMask() {
+    class_mask_.clear();
+    if (config_.allowed_classes.empty()) {
+        return;
+    }
+
+    class_mask_.assign(class_names_.size(), false);
+    for (const auto& name : config_.allowed_classes) {
+        auto it = std::find(class_names_.begin(), class_names_.end(), name);
+        if (it == class_names_.end()) {
+            WARN_LOG("Class '" + name + "' is not known to model " + config_.name);
+            continue;
+        }
+        class_mask_[it - class_names_.begin()] = true;
+    }
+}
+
+bool DetectorModel::IsClassAllowed(int class_id) const {
+    if (class_id < 0) {
+        return false;
+    }
+    if (class_mask_.empty()) {
+        return true;
+    }
+    return class_id < static_cast<int>(class_mask_.size()) && class_mask_[class_id];
+}
+
+std::string DetectorModel::ClassName(int class_id) const {
+    if (class_id < 0 || class_id >= static_cast<int>(class_names_.size())) {
+        return "class_" + std::to_string(class_id);
+    }
+    return class_names_[class_id];
+}
+
+/*
+ * YOLO (Darknet)
+ */
+YoloDarknetModel::YoloDarknetModel(const ModelConfig& config)
+    : DetectorModel(config) {
+}
+
+cv::dnn::Net YoloDarknetModel::ReadNet() const {
+    return cv::dnn::readNetFromDarknet(config_.config_path, config_.model_path);
+}
+
+std::vector<std::string> YoloDarknetModel::DefaultClassNames() const {
+    return COCO_CLASSES;
+}
+
+void YoloDarknetModel::Decode(const std::vector<cv::Mat>& outs, int batch_index, int batch_size,
+                              const cv::Size& frame_size, DetectionCandidates& candidates) const {
+    // Rows are [cx, cy, w, h, objectness, class scores...], class scores already include objectness
+    for (const auto& batch_out : outs) {
+        const cv::Mat out = BatchSlice(batch_out, batch_index, batch_size);
+        const int num_classes = out.cols - 5;
+        for (int i = 0; i < out.rows; ++i) {
+            const float* row = out.ptr<float>(i);
+
+            // A class score can never exceed the objectness, most rows stop here
+            if (row[4] <= config_.conf_threshold) {
+                continue;
+            }
+
+            float confidence;
+            int class_id = ArgMax(row + 5, num_classes, confidence);
+            if (confidence <= config_.conf_threshold || !IsClassAllowed(class_id)) {
+                continue;
+            }
+
+            // Boxes are normalized center/size
+            int center_x = static_cast<int>(row[0] * frame_size.width);
+            int center_y = static_cast<int>(row[1] * frame_size.height);
+            int width = static_cast<int>(row[2] * frame_size.width);
+            int height = static_cast<int>(row[3] * frame_size.height);
+            candidates.Add(cv::Rect(center_x - width / 2, center_y - height / 2, width, height),
+                           confidence, class_id);
+        }
+    }
+}
+
+/*
+ * YOLOv8 (ONNX)
+ */
+YoloV8OnnxModel::YoloV8OnnxModel(const ModelConfig& config)
+    : DetectorModel(config) {
+}
+
+cv::dnn::Net YoloV8OnnxModel::ReadNet() const {
+    return cv::dnn::readNetFromONNX(config_.model_path);
+}
+
+std::vector<std::string> YoloV8OnnxModel::DefaultClassNames() const {
+    return COCO_CLASSES;
+}
+
+void YoloV8OnnxModel::Decode(const std::vector<cv::Mat>& outs, int batch_index, int /*batch_size*/,
+                             const cv::Size& frame_size, DetectionCandidates& candidates) const {
+    if (outs.empty() || outs[0].dims != 3) {
+        return;
+    }
+
+    // [batch, 4 + classes, N], one plane per box coordinate and per class
+    const cv::Mat& out = outs[0];
+    const int channels = out.size[1];
+    const int count = out.size[2];
+    if (channels <= 4 || batch_index >= out.size[0]) {
+        return;
+    }
+    const float* data = out.ptr<float>(batch_index);
+
+    std::vector<float> best;
+    std::vector<int> best_class;
+    ArgMaxColumns(data + 4 * static_cast<size_t>(count), channels - 4, count, best, best_class);
+
+    const float x_factor = static_cast<float>(frame_size.width) / config_.input_size.width;
+    const float y_factor = static_cast<float>(frame_size.height) / config_.input_size.height;
+    const float* cx = data;
+    const float* cy = data + count;
+    const float* w = data + 2 * static_cast<size_t>(count);
+    const float* h = data + 3 * static_cast<size_t>(count);
+
+    for (int i = 0; i < count; ++i) {
+        if (best[i] <= config_.conf_threshold || !IsClassAllowed(best_class[i])) {
+            continue;
+        }
+
+        // Boxes are center/size in input pixels
+        int width = static_cast<int>(w[i] * x_factor);
+        int height = static_cast<int>(h[i] * y_factor);
+        candidates.Add(cv::Rect(static_cast<int>(cx[i] * x_factor) - width / 2,
+                                static_cast<int>(cy[i] * y_factor) - height / 2, width, height),
+                       best[i], best_class[i]);
+    }
+}
+
+/*
+ * MobileNet-SSD (Caffe)
+ */
+SsdModel::SsdModel(const ModelConfig& config)
+    : DetectorModel(config) {
+    scale_ = 1.0 / 127.5;
+    mean_ = cv::Scalar(127.5, 127.5, 127.5);
+    swap_rb_ = false;
+    apply_nms_ = false;
+}
+
+cv::dnn::Net SsdModel::ReadNet() const {
+    return cv::dnn::readNetFromCaffe(config_.config_path, config_.model_path);
+}
+
+std::vector<std::string> SsdModel::DefaultClassNames() const {
+    return VOC_CLASSES;
+}
+
+void SsdModel::Decode(const std::vector<cv::Mat>& outs, int batch_index, int /*batch_size*/,
+                      const cv::Size& frame_size, DetectionCandidates& candidates) const {
+    if (outs.empty()) {
+        return;
+    }
+
+    // [1, 1, N, 7], detections of all images in the batch tagged with their image index
+    const cv::Mat& out = outs[0];
+    const int count = static_cast<int>(out.total() / 7);
+    const float* data = out.ptr<float>();
+
+    for (int i = 0; i < count; ++i) {
+        const float* row = data + i * 7;
+        if (static_cast<int>(row[0]) != batch_index) {
+            continue;
+        }
+        float confidence = row[2];
+        int class_id = static_cast<int>(row[1]);
+        if (confidence <= config_.conf_threshold || !IsClassAllowed(class_id)) {
+            continue;
+        }
+
+        // Boxes are normalized corners
+        int x1 = static_cast<int>(row[3] * frame_size.width);
+        int y1 = static_cast<int>(row[4] * frame_size.height);
+        int x2 = static_cast<int>(row[5] * frame_size.width);
+        int y2 = static_cast<int>(row[6] * frame_size.height);
+        candidates.Add(cv::Rect(cv::Point(x1, y1), cv::Point(x2, y2)), confidence, class_id);
+    }
+}
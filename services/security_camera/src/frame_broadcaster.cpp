@@ -0,0 +1,63 @@
+#include "frame_broadcaster.h"
+#include "log.h"
+#include <opencv2/imgcodecs.hpp>
+
+FrameBroadcaster::FrameBroadcaster(int jpeg_quality)
+    : encode_params_{cv::IMWRITE_JPEG_QUALITY, jpeg_quality} {
+}
+
+EncodedFramePtr FrameBroadcaster::Publish(const cv::Mat& frame) {
+    if (frame.empty()) {
+        return nullptr;
+    }
+
+    auto encoded = std::make_shared<EncodedFrame>();
+    try {
+        if (!cv::imencode(".jpg", frame, encoded->jpeg, encode_params_)) {
+            WARN_LOG("Failed to encode frame for broadcast");
+            return nullptr;
+        }
+    } catch (const cv::Exception& e) {
+        ERROR_LOG("OpenCV error while encoding frame: " + std::string(e.what()));
+        return nullptr;
+    }
+
+    return Finalize(std::move(encoded), frame.cols, frame.rows);
+}
+
+EncodedFramePtr FrameBroadcaster::PublishEncoded(const uint8_t* jpeg, size_t size, int width, int height) {
+    if (!jpeg || size == 0) {
+        return nullptr;
+    }
+
+    auto encoded = std::make_shared<EncodedFrame>();
+    encoded->jpeg.assign(jpeg, jpeg + size);
+    return Finalize(std::move(encoded), width, height);
+}
+
+EncodedFramePtr FrameBroadcaster::Finalize(std::shared_ptr<EncodedFrame> encoded, int width, int height) {
+    encoded->sequence = sequence_.fetch_add(1) + 1;
+    encoded->timestamp = std::chrono::steady_clock::now();
+    encoded->width = width;
+    encoded->height = height;
+    encoded->part_header = "--mjpegstream\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: " + std::to_string(encoded->jpeg.size()) + "\r\n\r\n";
+
+    EncodedFramePtr published = std::move(encoded);
+    {
+        std::lock_guard<std::mutex> lock(latest_mutex_);
+        latest_ = published;
+    }
+    return published;
+}
+
+EncodedFramePtr FrameBroadcaster::Latest() const {
+    std::lock_guard<std::mutex> lock(latest_mutex_);
+    return latest_;
+}
+
+void FrameBroadcaster::Reset() {
+    std::lock_guard<std::mutex> lock(latest_mutex_);
+    latest_.reset();
+}
@@ -0,0 +1,11 @@
+#include "frame_channel.h"
+
+void FrameChannel::Publish(const cv::Mat& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_ = frame;
+}
+
+cv::Mat FrameChannel::Latest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frame_;
+}
@@ -1,7 +1,7 @@
 #include "frame_processor.h"
 #include "log.h"
+#include <algorithm>
 #include <chrono>
-#include <fstream>
 
 json DetectionResult::ToJson() const {
     json result;
@@ -27,25 +27,18 @@ json DetectionResult::ToJson() const {
     return result;
 }
 
-FrameProcessor::FrameProcessor() {
-    // Initialize class names we care about
-    class_names_ = {"person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat",
-                   "bird", "cat", "dog", "horse", "sheep", "cow", "elephant", "bear", "zebra", "giraffe"};
+FrameProcessor::FrameProcessor(const ModelConfig& config)
+    : config_(config) {
 }
 
 FrameProcessor::~FrameProcessor() = default;
 
 bool FrameProcessor::Initialize() {
     try {
-        // Load YOLO network
-        net_ = cv::dnn::readNetFromDarknet(
-            "/usr/local/lib/security_camera/yolov3.cfg",
-            "/usr/local/lib/security_camera/yolov3.weights"
-        );
-
-        net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-        INFO_LOG("Using CPU backend for inference");
+        model_ = DetectorModel::Create(config_);
+        if (!model_->Load()) {
+            return false;
+        }
 
         INFO_LOG("Frame processor initialized successfully");
         return true;
@@ -58,78 +51,186 @@ bool FrameProcessor::Initialize() {
     }
 }
 
-DetectionResult FrameProcessor::ProcessFrame(cv::Mat& frame) {
+DetectionResult FrameProcessor::ProcessFrame(cv::Mat& frame, const InferenceRegions* regions) {
     auto start = std::chrono::steady_clock::now();
     
     DetectionResult result;
-    result.detections = Detect(frame);
+    if (regions && !regions->FullFrame()) {
+        result.detections = std::move(DetectRegions({frame}, {regions}).front());
+    } else {
+        result.detections = Detect(frame);
+    }
     DrawDetections(frame, result.detections);
     
     auto end = std::chrono::steady_clock::now();
     result.latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    result.fps = UpdateFPS(1, end);
+    
+    return result;
+}
+
+std::vector<DetectionResult> FrameProcessor::ProcessBatch(std::vector<cv::Mat>& frames,
+                                                          const std::vector<const InferenceRegions*>& regions) {
+    auto start = std::chrono::steady_clock::now();
+    
+    bool cropped = std::any_of(regions.begin(), regions.end(),
+                               [](const InferenceRegions* r) { return r && !r->FullFrame(); });
+    auto batch_detections = cropped ? DetectRegions(frames, regions) : model_->DetectBatch(frames);
     
-    // Calculate FPS
-    static auto last_time = start;
-    static int frame_count = 0;
-    frame_count++;
+    auto end = std::chrono::steady_clock::now();
+    double latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    double fps = UpdateFPS(static_cast<int>(frames.size()), end);
+    
+    std::vector<DetectionResult> results(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        results[i].detections = std::move(batch_detections[i]);
+        results[i].latency_ms = latency_ms;
+        results[i].fps = fps;
+        DrawDetections(frames[i], results[i].detections);
+    }
     
-    auto time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(end - last_time).count();
+    return results;
+}
+
+double FrameProcessor::UpdateFPS(int frames, std::chrono::steady_clock::time_point now) {
+    fps_frame_count_ += frames;
+    
+    auto time_diff = std::chrono::duration_cast<std::chrono::milliseconds>(now - fps_window_start_).count();
     if (time_diff >= 1000) {  // Update FPS every second
-        result.fps = frame_count * 1000.0 / time_diff;
-        frame_count = 0;
-        last_time = end;
+        fps_ = fps_frame_count_ * 1000.0 / time_diff;
+        fps_frame_count_ = 0;
+        fps_window_start_ = now;
     }
     
-    return result;
+    return fps_;
 }
 
 std::vector<Detection> FrameProcessor::Detect(const cv::Mat& frame) {
-    std::vector<Detection> detections;
-    
-    // Create blob from image
-    cv::Mat blob = cv::dnn::blobFromImage(frame, 1/255.0, cv::Size(416, 416), cv::Scalar(), true, false);
-    net_.setInput(blob);
-    
-    // Get output layer names
-    std::vector<cv::String> outLayerNames = net_.getUnconnectedOutLayersNames();
-    std::vector<cv::Mat> outs;
-    net_.forward(outs, outLayerNames);
-    
-    // Process detections
-    for (const auto& out : outs) {
-        for (int i = 0; i < out.rows; ++i) {
-            cv::Mat scores = out.row(i).colRange(5, out.cols);
-            cv::Point classIdPoint;
-            double confidence;
-            cv::minMaxLoc(scores, nullptr, &confidence, nullptr, &classIdPoint);
-            
-            if (confidence > conf_threshold_) {
-                int class_id = classIdPoint.x;
-                std::string class_name = class_names_[class_id];
-                
-                // Only keep people, vehicles, and animals
-                if (class_name == "person" || 
-                    class_name == "car" || class_name == "truck" || class_name == "bus" || class_name == "motorcycle" ||
-                    class_name == "dog" || class_name == "cat" || class_name == "bird") {
-                    
-                    Detection det;
-                    det.class_name = class_name;
-                    det.confidence = static_cast<float>(confidence);
-                    
-                    // Get bounding box
-                    int centerX = static_cast<int>(out.at<float>(i, 0) * frame.cols);
-                    int centerY = static_cast<int>(out.at<float>(i, 1) * frame.rows);
-                    int width = static_cast<int>(out.at<float>(i, 2) * frame.cols);
-                    int height = static_cast<int>(out.at<float>(i, 3) * frame.rows);
-                    det.box = cv::Rect(centerX - width/2, centerY - height/2, width, height);
-                    
-                    detections.push_back(det);
+    // Class filtering and NMS happen while decoding
+    return model_->Detect(frame);
+}
+
+std::vector<std::vector<Detection>> FrameProcessor::DetectRegions(
+    const std::vector<cv::Mat>& frames, const std::vector<const InferenceRegions*>& regions) {
+    crops_.clear();
+    crop_origins_.clear();
+    std::vector<size_t> crop_counts(frames.size(), 0);
+    
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const InferenceRegions* frame_regions = i < regions.size() ? regions[i] : nullptr;
+        if (!frame_regions || frame_regions->FullFrame()) {
+            crops_.push_back(frames[i]);
+            crop_origins_.emplace_back(i, cv::Point(0, 0));
+            crop_counts[i]++;
+            continue;
+        }
+        // Crops are views into the frame, nothing is copied until the blob is built
+        for (const auto& rect : PlanCrops(frames[i].size(), *frame_regions)) {
+            crops_.push_back(frames[i](rect));
+            crop_origins_.emplace_back(i, rect.tl());
+            crop_counts[i]++;
+        }
+    }
+    
+    std::vector<std::vector<Detection>> results(frames.size());
+    if (!crops_.empty()) {
+        auto crop_detections = model_->DetectBatch(crops_);
+        for (size_t c = 0; c < crop_detections.size(); ++c) {
+            const auto& [frame, origin] = crop_origins_[c];
+            for (auto& det : crop_detections[c]) {
+                det.box += origin;
+                results[frame].push_back(std::move(det));
+            }
+        }
+    }
+    
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const InferenceRegions* frame_regions = i < regions.size() ? regions[i] : nullptr;
+        if (frame_regions && !frame_regions->FullFrame()) {
+            MergeDetections(results[i], frames[i].size(), *frame_regions, crop_counts[i] > 1);
+        }
+    }
+    
+    // Don't hold on to the frames between batches
+    crops_.clear();
+    return results;
+}
+
+std::vector<cv::Rect> FrameProcessor::PlanCrops(const cv::Size& frame_size, const InferenceRegions& regions) const {
+    std::vector<cv::Rect> areas;
+    if (regions.regions.empty()) {
+        areas.emplace_back(cv::Point(0, 0), frame_size);
+    } else {
+        for (const auto& region : regions.regions) {
+            cv::Rect bounds = RegionBounds(region, frame_size);
+            if (!bounds.empty()) {
+                areas.push_back(bounds);
+            }
+        }
+    }
+    
+    // Overlapping regions are inferred once through their combined bounding box.
+    // A grown box can reach an area checked earlier, so repeat until nothing merges.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < areas.size(); ++i) {
+            for (size_t j = i + 1; j < areas.size(); ++j) {
+                if ((areas[i] & areas[j]).empty()) {
+                    continue;
                 }
+                areas[i] |= areas[j];
+                areas.erase(areas.begin() + j);
+                j = i;
+                merged = true;
             }
         }
     }
     
-    return detections;
+    if (!regions.tile) {
+        return areas;
+    }
+    
+    // Native resolution tiles, the tile budget is shared between the areas
+    std::vector<cv::Rect> tiles;
+    int tiles_per_area = std::max(1, regions.max_tiles / std::max(1, static_cast<int>(areas.size())));
+    for (const auto& area : areas) {
+        auto area_tiles = TileArea(area, config_.input_size, regions.tile_overlap, tiles_per_area);
+        tiles.insert(tiles.end(), area_tiles.begin(), area_tiles.end());
+    }
+    return tiles;
+}
+
+void FrameProcessor::MergeDetections(std::vector<Detection>& detections, const cv::Size& frame_size,
+                                     const InferenceRegions& regions, bool overlapping) const {
+    if (overlapping && detections.size() > 1) {
+        // An object in the overlap of two crops is detected in both
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        std::vector<int> class_ids;
+        for (const auto& det : detections) {
+            boxes.push_back(det.box);
+            scores.push_back(det.confidence);
+            class_ids.push_back(det.class_id);
+        }
+        std::vector<int> keep;
+        cv::dnn::NMSBoxesBatched(boxes, scores, class_ids, 0.0f, config_.nms_threshold, keep);
+        
+        std::vector<Detection> merged;
+        merged.reserve(keep.size());
+        for (int idx : keep) {
+            merged.push_back(std::move(detections[idx]));
+        }
+        detections = std::move(merged);
+    }
+    
+    if (!regions.regions.empty()) {
+        // Crops are rectangles, the polygon decides where an object stands
+        detections.erase(std::remove_if(detections.begin(), detections.end(), [&](const Detection& det) {
+            cv::Point ground(det.box.x + det.box.width / 2, det.box.y + det.box.height - 1);
+            return !RegionsContain(regions.regions, frame_size, ground);
+        }), detections.end());
+    }
 }
 
 void FrameProcessor::DrawDetections(cv::Mat& frame, const std::vector<Detection>& detections) {
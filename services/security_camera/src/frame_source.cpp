@@ -0,0 +1,197 @@
+#include "frame_source.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+
+std::string Lowercase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+    return value;
+}
+
+}
+
+FrameSource::FrameSource(const std::string& spec, int width, int height, int fps, bool realtime, bool loop)
+    : spec_(spec), width_(width), height_(height), fps_(std::max(1, fps)), realtime_(realtime), loop_(loop) {
+}
+
+bool FrameSource::Open() {
+    namespace fs = std::filesystem;
+
+    if (spec_.empty() || spec_ == "pattern") {
+        kind_ = Kind::PATTERN;
+        // Static gradient so motion detection only sees the moving object
+        background_.create(height_, width_, CV_8UC3);
+        for (int y = 0; y < height_; ++y) {
+            background_.row(y).setTo(cv::Scalar(60 + 120 * y / height_, 90, 140 - 80 * y / height_));
+        }
+    } else if (fs::is_directory(spec_)) {
+        kind_ = Kind::IMAGES;
+        for (const auto& entry : fs::directory_iterator(spec_)) {
+            std::string extension = Lowercase(entry.path().extension().string());
+            if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp") {
+                images_.push_back(entry.path().string());
+            }
+        }
+        std::sort(images_.begin(), images_.end());
+        if (images_.empty()) {
+            ERROR_LOG("No images in frame source directory " + spec_);
+            return false;
+        }
+        cv::Mat first = cv::imread(images_.front());
+        if (!first.empty()) {
+            width_ = first.cols;
+            height_ = first.rows;
+        }
+    } else {
+        kind_ = Kind::VIDEO;
+        if (!video_.open(spec_)) {
+            ERROR_LOG("Failed to open frame source video " + spec_);
+            return false;
+        }
+        width_ = static_cast<int>(video_.get(cv::CAP_PROP_FRAME_WIDTH));
+        height_ = static_cast<int>(video_.get(cv::CAP_PROP_FRAME_HEIGHT));
+        double video_fps = video_.get(cv::CAP_PROP_FPS);
+        if (video_fps > 0) {
+            fps_ = static_cast<int>(std::lround(video_fps));
+        }
+    }
+
+    opened_ = true;
+    next_frame_time_ = std::chrono::steady_clock::now();
+    INFO_LOG("Frame source " + (spec_.empty() ? std::string("pattern") : spec_) + " opened at " +
+             std::to_string(fps_) + " fps" + (realtime_ ? "" : ", unpaced"));
+    return true;
+}
+
+bool FrameSource::IsOpened() const {
+    return opened_;
+}
+
+bool FrameSource::Grab() {
+    if (!opened_) {
+        return false;
+    }
+
+    if (realtime_) {
+        std::this_thread::sleep_until(next_frame_time_);
+        next_frame_time_ = std::max(next_frame_time_ + std::chrono::microseconds(1000000 / fps_),
+                                    std::chrono::steady_clock::now());
+    }
+
+    bool grabbed = true;
+    switch (kind_) {
+        case Kind::IMAGES:
+            grabbed = GrabImage();
+            break;
+        case Kind::VIDEO:
+            grabbed = GrabVideo();
+            break;
+        case Kind::PATTERN:
+            break;
+    }
+    if (grabbed) {
+        frames_++;
+    }
+    return grabbed;
+}
+
+bool FrameSource::GrabImage() {
+    if (image_index_ >= images_.size()) {
+        if (!loop_) {
+            return false;
+        }
+        image_index_ = 0;
+    }
+
+    const std::string& path = images_[image_index_++];
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        WARN_LOG("Failed to read frame source image " + path);
+        return false;
+    }
+    image_bytes_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    std::string extension = Lowercase(std::filesystem::path(path).extension().string());
+    image_is_jpeg_ = extension == ".jpg" || extension == ".jpeg";
+    return !image_bytes_.empty();
+}
+
+bool FrameSource::GrabVideo() {
+    if (video_.grab()) {
+        return true;
+    }
+    if (!loop_) {
+        return false;
+    }
+    video_.set(cv::CAP_PROP_POS_FRAMES, 0);
+    return video_.grab();
+}
+
+cv::Mat FrameSource::Retrieve() {
+    cv::Mat frame;
+    switch (kind_) {
+        case Kind::IMAGES:
+            frame = cv::imdecode(image_bytes_, cv::IMREAD_COLOR);
+            break;
+        case Kind::VIDEO:
+            video_.retrieve(frame);
+            break;
+        case Kind::PATTERN:
+            frame = RenderPattern();
+            break;
+    }
+    return frame;
+}
+
+cv::Mat FrameSource::RenderPattern() const {
+    cv::Mat frame = background_.clone();
+
+    // A person-sized box walking back and forth across the frame
+    const int period = fps_ * 10;
+    double phase = static_cast<double>(frames_ % period) / period;
+    double position = phase < 0.5 ? phase * 2 : 2 - phase * 2;
+    int box_width = std::max(8, width_ / 10);
+    int box_height = std::max(16, height_ / 3);
+    int x = static_cast<int>(position * (width_ - box_width));
+    int y = height_ - box_height - height_ / 10;
+    cv::rectangle(frame, cv::Rect(x, y, box_width, box_height), cv::Scalar(40, 40, 200), cv::FILLED);
+
+    cv::putText(frame, std::to_string(frames_), cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 1.0,
+                cv::Scalar(255, 255, 255), 2);
+    return frame;
+}
+
+bool FrameSource::GetEncoded(const uint8_t*& data, size_t& size) const {
+    if (kind_ != Kind::IMAGES || !image_is_jpeg_ || image_bytes_.empty()) {
+        return false;
+    }
+    data = image_bytes_.data();
+    size = image_bytes_.size();
+    return true;
+}
+
+FrameSource::Kind FrameSource::GetKind() const {
+    return kind_;
+}
+
+uint64_t FrameSource::Frames() const {
+    return frames_;
+}
+
+int FrameSource::Width() const {
+    return width_;
+}
+
+int FrameSource::Height() const {
+    return height_;
+}
+
+int FrameSource::FPS() const {
+    return fps_;
+}
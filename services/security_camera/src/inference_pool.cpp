@@ -0,0 +1,193 @@
+#include "inference_pool.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+
+InferencePool::InferencePool(const ModelConfig& config, size_t num_cameras, size_t max_batch,
+                             size_t queue_depth, int num_workers, const SchedulerConfig& schedule)
+    : config_(config),
+      max_batch_(std::max<size_t>(1, max_batch)),
+      queue_depth_(std::max<size_t>(1, queue_depth)),
+      queues_(num_cameras),
+      scheduler_(schedule, num_cameras, std::max(1, num_workers)) {
+    for (int i = 0; i < std::max(1, num_workers); ++i) {
+        processors_.push_back(std::make_unique<FrameProcessor>(config_));
+    }
+}
+
+InferencePool::~InferencePool() {
+    Stop();
+}
+
+bool InferencePool::Initialize() {
+    // Several workers already use the cores, nested OpenCV threads would only
+    // oversubscribe them. Each worker's thread clock is then its whole cost.
+    if (processors_.size() > 1) {
+        cv::setNumThreads(1);
+    }
+
+    for (auto& processor : processors_) {
+        if (!processor->Initialize()) {
+            return false;
+        }
+    }
+
+    INFO_LOG("Inference pool ready: " + std::to_string(processors_.size()) + " worker(s), batch " +
+             std::to_string(max_batch_) + ", queue depth " + std::to_string(queue_depth_) + " for " +
+             std::to_string(queues_.size()) + " camera(s)");
+    return true;
+}
+
+void InferencePool::Start(ResultCallback callback) {
+    if (running_) {
+        return;
+    }
+
+    callback_ = std::move(callback);
+    running_ = true;
+    for (auto& processor : processors_) {
+        workers_.emplace_back(&InferencePool::WorkerLoop, this, processor.get());
+    }
+}
+
+void InferencePool::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    queue_cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+    DEBUG_LOG("Inference workers joined");
+}
+
+void InferencePool::SetRegions(size_t camera, const InferenceRegions& regions) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (camera < queues_.size()) {
+        queues_[camera].regions = regions;
+    }
+}
+
+void InferencePool::Submit(size_t camera, const cv::Mat& frame, std::chrono::steady_clock::time_point captured) {
+    if (frame.empty() || camera >= queues_.size()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CameraQueue& queue = queues_[camera];
+        if (queue.frames.size() >= queue_depth_) {
+            // Keep latency bounded, a stale frame is worth less than the new one
+            queue.frames.pop_front();
+            queue.dropped++;
+            pending_--;
+        }
+        queue.frames.push_back({frame, captured});
+        pending_++;
+    }
+    queue_cv_.notify_one();
+}
+
+InferenceScheduler& InferencePool::Scheduler() {
+    return scheduler_;
+}
+
+uint64_t InferencePool::DroppedFrames(size_t camera) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return camera < queues_.size() ? queues_[camera].dropped : 0;
+}
+
+size_t InferencePool::QueueDepth(size_t camera) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return camera < queues_.size() ? queues_[camera].frames.size() : 0;
+}
+
+void InferencePool::TakeBatch(std::vector<cv::Mat>& frames, std::vector<size_t>& cameras,
+                              std::vector<const InferenceRegions*>& regions,
+                              std::vector<std::chrono::steady_clock::time_point>& captured) {
+    // Round-robin so a busy camera cannot starve the others out of the batch
+    while (frames.size() < max_batch_ && pending_ > 0) {
+        for (size_t n = 0; n < queues_.size() && frames.size() < max_batch_; ++n) {
+            size_t camera = (next_camera_ + n) % queues_.size();
+            CameraQueue& queue = queues_[camera];
+            if (queue.frames.empty()) {
+                continue;
+            }
+            frames.push_back(std::move(queue.frames.front().frame));
+            captured.push_back(queue.frames.front().captured);
+            queue.frames.pop_front();
+            cameras.push_back(camera);
+            regions.push_back(&queue.regions);
+            pending_--;
+        }
+    }
+    next_camera_ = (next_camera_ + 1) % std::max<size_t>(1, queues_.size());
+}
+
+void InferencePool::WorkerLoop(FrameProcessor* processor) {
+    INFO_LOG("Inference worker started");
+
+    std::vector<cv::Mat> frames;
+    std::vector<size_t> cameras;
+    std::vector<const InferenceRegions*> regions;
+    std::vector<std::chrono::steady_clock::time_point> captured;
+    frames.reserve(max_batch_);
+    cameras.reserve(max_batch_);
+    regions.reserve(max_batch_);
+    captured.reserve(max_batch_);
+
+    while (true) {
+        frames.clear();
+        cameras.clear();
+        regions.clear();
+        captured.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cv_.wait(lock, [this] { return !running_ || pending_ > 0; });
+            if (!running_) {
+                break;
+            }
+            TakeBatch(frames, cameras, regions, captured);
+        }
+
+        // Detections are drawn onto the frames, keep the captured ones untouched
+        for (auto& frame : frames) {
+            frame = frame.clone();
+        }
+
+        try {
+            // A single worker lets OpenCV spread the forward pass over its threads, which
+            // only the process clock sees. Capture and streaming during the batch are
+            // counted too, erring on the side of the budget.
+            auto cpu_ms = processors_.size() > 1 ? &InferenceScheduler::ThreadCpuMs
+                                                 : &InferenceScheduler::ProcessCpuMs;
+            auto wall_start = std::chrono::steady_clock::now();
+            double cpu_start = cpu_ms();
+            auto results = processor->ProcessBatch(frames, regions);
+            scheduler_.RecordBatch(frames.size(),
+                                   std::chrono::duration<double, std::milli>(
+                                       std::chrono::steady_clock::now() - wall_start).count(),
+                                   cpu_ms() - cpu_start);
+            for (size_t i = 0; i < results.size(); ++i) {
+                results[i].captured = captured[i];
+                if (callback_) {
+                    callback_(cameras[i], frames[i], results[i]);
+                }
+            }
+        } catch (const cv::Exception& e) {
+            ERROR_LOG("OpenCV error during inference: " + std::string(e.what()));
+        } catch (const std::exception& e) {
+            ERROR_LOG("Error during inference: " + std::string(e.what()));
+        }
+    }
+
+    INFO_LOG("Inference worker stopped");
+}
@@ -0,0 +1,134 @@
+#include "inference_scheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <time.h>
+
+InferenceScheduler::InferenceScheduler(const SchedulerConfig& config, size_t num_cameras, int num_workers)
+    : config_(config),
+      num_workers_(std::max(1, num_workers)),
+      cameras_(num_cameras) {
+    config_.cpu_budget = std::max(0.0, config_.cpu_budget);
+    config_.idle_fps = std::max(0.0, config_.idle_fps);
+    config_.active_fps = std::max(config_.idle_fps, config_.active_fps);
+    std::lock_guard<std::mutex> lock(mutex_);
+    Allocate();
+}
+
+bool InferenceScheduler::ShouldInfer(size_t camera, bool active, std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (camera >= cameras_.size()) {
+        return false;
+    }
+
+    CameraSchedule& schedule = cameras_[camera];
+    if (schedule.active != active) {
+        schedule.active = active;
+        Allocate();
+        // Look at whatever just started moving right away
+        if (active) {
+            schedule.next_due = now;
+        }
+    }
+
+    if (schedule.rate <= 0.0 || now < schedule.next_due) {
+        schedule.skipped++;
+        return false;
+    }
+
+    // Keep the cadence when frames land a little late, but never catch up in a burst
+    auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / schedule.rate));
+    schedule.next_due = std::max(schedule.next_due + interval, now);
+    schedule.inferred++;
+    return true;
+}
+
+void InferenceScheduler::RecordBatch(size_t frames, double wall_ms, double cpu_ms) {
+    if (frames == 0) {
+        return;
+    }
+    batch_latency_.Record(wall_ms);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    double cpu_per_frame = std::max(0.0, cpu_ms) / frames;
+    double wall_per_frame = std::max(0.0, wall_ms) / frames;
+    if (wall_ms_per_frame_ <= 0.0) {
+        cpu_ms_per_frame_ = cpu_per_frame;
+        wall_ms_per_frame_ = wall_per_frame;
+    } else {
+        cpu_ms_per_frame_ += COST_ALPHA * (cpu_per_frame - cpu_ms_per_frame_);
+        wall_ms_per_frame_ += COST_ALPHA * (wall_per_frame - wall_ms_per_frame_);
+    }
+    Allocate();
+}
+
+void InferenceScheduler::Allocate() {
+    double capacity = std::numeric_limits<double>::infinity();
+    if (config_.cpu_budget > 0.0 && cpu_ms_per_frame_ > 0.0) {
+        capacity = config_.cpu_budget * 1000.0 / cpu_ms_per_frame_;
+    }
+    if (wall_ms_per_frame_ > 0.0) {
+        capacity = std::min(capacity, WORKER_HEADROOM * num_workers_ * 1000.0 / wall_ms_per_frame_);
+    }
+    capacity_fps_ = std::isinf(capacity) ? 0.0 : capacity;
+    if (cameras_.empty()) {
+        return;
+    }
+
+    // Every camera keeps its idle cadence first so a quiet one is never blind,
+    // what is left goes to the active ones
+    size_t active = std::count_if(cameras_.begin(), cameras_.end(),
+                                  [](const CameraSchedule& schedule) { return schedule.active; });
+    double base = std::min(config_.idle_fps, capacity / cameras_.size());
+    double spare = std::max(0.0, capacity - base * cameras_.size());
+    double boost = active > 0 ? std::min(config_.active_fps - base, spare / active) : 0.0;
+
+    for (auto& schedule : cameras_) {
+        schedule.rate = base + (schedule.active ? std::max(0.0, boost) : 0.0);
+    }
+}
+
+double InferenceScheduler::Rate(size_t camera) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return camera < cameras_.size() ? cameras_[camera].rate : 0.0;
+}
+
+nlohmann::json InferenceScheduler::Metrics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double total_rate = 0.0;
+    nlohmann::json cameras = nlohmann::json::array();
+    for (const auto& schedule : cameras_) {
+        total_rate += schedule.rate;
+        cameras.push_back({
+            {"active", schedule.active},
+            {"rate_fps", schedule.rate},
+            {"inferred", schedule.inferred},
+            {"skipped", schedule.skipped}
+        });
+    }
+
+    return {
+        {"cpu_budget", config_.cpu_budget},
+        {"cpu_ms_per_frame", cpu_ms_per_frame_},
+        {"wall_ms_per_frame", wall_ms_per_frame_},
+        // 0 until the first batch has been measured
+        {"capacity_fps", capacity_fps_},
+        // Cores the granted rates are expected to keep busy
+        {"expected_cpu", total_rate * cpu_ms_per_frame_ / 1000.0},
+        {"batch_latency", batch_latency_.ToJson()},
+        {"cameras", cameras}
+    };
+}
+
+double InferenceScheduler::ThreadCpuMs() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+double InferenceScheduler::ProcessCpuMs() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
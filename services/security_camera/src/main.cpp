@@ -16,6 +16,8 @@ void signalHandler(int signum) {
 int main() {
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
+    // Stream clients can disappear mid-write, handle that as an error instead of terminating
+    std::signal(SIGPIPE, SIG_IGN);
 
     std::string broker_address = std::getenv("MQTT_BROKER");
     if (broker_address.empty()) {
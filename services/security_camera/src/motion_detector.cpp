@@ -0,0 +1,57 @@
+#include "motion_detector.h"
+#include "log.h"
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+MotionDetector::MotionDetector(double threshold, int width, const std::vector<Region>& regions)
+    : threshold_(threshold), width_(std::max(16, width)), regions_(regions) {
+}
+
+MotionResult MotionDetector::Detect(const cv::Mat& frame) {
+    MotionResult result;
+    if (frame.empty()) {
+        return result;
+    }
+
+    int height = std::max(1, frame.rows * width_ / std::max(1, frame.cols));
+    cv::resize(frame, small_, cv::Size(width_, height), 0, 0, cv::INTER_AREA);
+    if (small_.channels() == 3) {
+        cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+    } else {
+        small_.copyTo(gray_);
+    }
+    cv::GaussianBlur(gray_, gray_, cv::Size(5, 5), 0);
+
+    // First frame or resolution change, start a new background
+    if (background_.empty() || background_.size() != gray_.size()) {
+        gray_.convertTo(background_, CV_32F);
+        mask_ = RegionMask(regions_, gray_.size());
+        mask_pixels_ = cv::countNonZero(mask_);
+        return result;
+    }
+
+    background_.convertTo(background_u8_, CV_8U);
+    cv::absdiff(gray_, background_u8_, diff_);
+    cv::threshold(diff_, diff_, PIXEL_THRESHOLD, 255, cv::THRESH_BINARY);
+    cv::bitwise_and(diff_, mask_, diff_);
+
+    if (mask_pixels_ > 0) {
+        result.score = static_cast<double>(cv::countNonZero(diff_)) / mask_pixels_;
+    }
+    result.motion = result.score >= threshold_;
+
+    cv::accumulateWeighted(gray_, background_, BACKGROUND_RATE);
+    return result;
+}
+
+void MotionDetector::Reset() {
+    background_.release();
+}
+
+void MotionDetector::SetThreshold(double threshold) {
+    threshold_ = threshold;
+}
+
+double MotionDetector::GetThreshold() const {
+    return threshold_;
+}
@@ -0,0 +1,188 @@
+#include "object_tracker.h"
+#include "log.h"
+#include <algorithm>
+#include <tuple>
+
+nlohmann::json TrackEvent::ToJson() const {
+    static const char* names[] = {"enter", "update", "exit"};
+    return {
+        {"event", names[static_cast<int>(type)]},
+        {"track_id", track_id},
+        {"class", class_name},
+        {"confidence", confidence},
+        {"box", {{"x", box.x}, {"y", box.y}, {"width", box.width}, {"height", box.height}}},
+        {"duration_s", duration_s}
+    };
+}
+
+ObjectTracker::ObjectTracker(const TrackerConfig& config)
+    : config_(config) {
+}
+
+float ObjectTracker::IoU(const cv::Rect& a, const cv::Rect& b) {
+    int intersection = (a & b).area();
+    int united = a.area() + b.area() - intersection;
+    return united > 0 ? static_cast<float>(intersection) / united : 0.0f;
+}
+
+TrackEvent ObjectTracker::MakeEvent(TrackEventType type, const Track& track, Clock::time_point now) const {
+    return TrackEvent{type, track.id, track.class_name, track.confidence, track.box,
+                      std::chrono::duration<double>(now - track.first_seen).count()};
+}
+
+void ObjectTracker::TakeSnapshot(Track& track, Clock::time_point now, TrackerOutput& output) {
+    if (track.best_frame.empty()) {
+        return;
+    }
+    output.snapshots.push_back({track.id, track.class_name, track.best_confidence, std::move(track.best_frame)});
+    track.snapshot_confidence = track.best_confidence;
+    track.best_frame = cv::Mat();
+    track.best_confidence = 0.0f;
+    track.last_snapshot = now;
+    track.snapshotted = true;
+}
+
+TrackerOutput ObjectTracker::Update(const std::vector<Detection>& detections, const cv::Mat& frame,
+                                    Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrackerOutput output;
+    // Several inference workers can finish a camera's frames out of order
+    if (now < last_update_) {
+        output.stale = true;
+        return output;
+    }
+    last_update_ = now;
+
+    // Greedy matching, best overlaps first
+    std::vector<std::tuple<float, size_t, size_t>> pairs;
+    for (size_t t = 0; t < tracks_.size(); ++t) {
+        for (size_t d = 0; d < detections.size(); ++d) {
+            if (tracks_[t].class_id != detections[d].class_id) {
+                continue;
+            }
+            float iou = IoU(tracks_[t].box, detections[d].box);
+            if (iou >= config_.iou_threshold) {
+                pairs.emplace_back(iou, t, d);
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+
+    std::vector<bool> track_matched(tracks_.size(), false);
+    std::vector<bool> detection_matched(detections.size(), false);
+    for (const auto& [iou, t, d] : pairs) {
+        if (track_matched[t] || detection_matched[d]) {
+            continue;
+        }
+        track_matched[t] = true;
+        detection_matched[d] = true;
+
+        Track& track = tracks_[t];
+        if (iou < config_.moving_iou) {
+            track.last_moved = now;
+        }
+        track.box = detections[d].box;
+        track.confidence = detections[d].confidence;
+        track.last_seen = now;
+        track.hits++;
+        if (track.confidence > track.best_confidence) {
+            track.best_confidence = track.confidence;
+            track.best_frame = frame;
+        }
+    }
+
+    for (size_t d = 0; d < detections.size(); ++d) {
+        if (detection_matched[d]) {
+            continue;
+        }
+        Track track;
+        track.id = next_id_++;
+        track.class_id = detections[d].class_id;
+        track.class_name = detections[d].class_name;
+        track.box = detections[d].box;
+        track.confidence = detections[d].confidence;
+        track.hits = 1;
+        track.first_seen = now;
+        track.last_seen = now;
+        track.last_moved = now;
+        track.best_confidence = track.confidence;
+        track.best_frame = frame;
+        tracks_.push_back(std::move(track));
+    }
+
+    const auto update_interval = std::chrono::milliseconds(config_.update_interval_ms);
+    const auto snapshot_interval = std::chrono::milliseconds(config_.snapshot_interval_ms);
+    for (Track& track : tracks_) {
+        if (track.last_seen != now) {
+            continue;
+        }
+        if (!track.confirmed) {
+            if (track.hits < config_.min_hits) {
+                continue;
+            }
+            track.confirmed = true;
+            track.last_event = now;
+            output.events.push_back(MakeEvent(TrackEventType::ENTER, track, now));
+            DEBUG_LOG("Track " + std::to_string(track.id) + " (" + track.class_name + ") entered");
+            TakeSnapshot(track, now, output);
+            continue;
+        }
+        if (now - track.last_event >= update_interval) {
+            track.last_event = now;
+            output.events.push_back(MakeEvent(TrackEventType::UPDATE, track, now));
+        }
+        if (now - track.last_snapshot >= snapshot_interval) {
+            TakeSnapshot(track, now, output);
+        }
+    }
+
+    ExpireLocked(now, output);
+    return output;
+}
+
+TrackerOutput ObjectTracker::Expire(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrackerOutput output;
+    ExpireLocked(now, output);
+    return output;
+}
+
+void ObjectTracker::SetInferenceInterval(Clock::duration interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inference_interval_ = interval;
+}
+
+void ObjectTracker::ExpireLocked(Clock::time_point now, TrackerOutput& output) {
+    // Without enough inferences in between a missing object can't be told from an unobserved one
+    const auto max_age = std::max<Clock::duration>(std::chrono::milliseconds(config_.max_age_ms),
+                                                   inference_interval_ * (config_.max_missed + 1));
+    auto stale = std::stable_partition(tracks_.begin(), tracks_.end(),
+        [&](const Track& track) { return now - track.last_seen < max_age; });
+
+    for (auto it = stale; it != tracks_.end(); ++it) {
+        if (!it->confirmed) {
+            continue;
+        }
+        // The exit carries the last place the object was seen
+        output.events.push_back(MakeEvent(TrackEventType::EXIT, *it, it->last_seen));
+        DEBUG_LOG("Track " + std::to_string(it->id) + " (" + it->class_name + ") exited");
+        // A better frame than the last snapshot showed up since, send it on the way out
+        if (it->snapshotted && it->best_confidence > it->snapshot_confidence) {
+            TakeSnapshot(*it, now, output);
+        }
+    }
+    tracks_.erase(stale, tracks_.end());
+}
+
+size_t ObjectTracker::ActiveTracks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(std::count_if(tracks_.begin(), tracks_.end(),
+        [](const Track& track) { return track.confirmed; }));
+}
+
+size_t ObjectTracker::MovingTracks(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto hold = std::chrono::milliseconds(config_.moving_hold_ms);
+    return static_cast<size_t>(std::count_if(tracks_.begin(), tracks_.end(),
+        [&](const Track& track) { return track.confirmed && now - track.last_moved < hold; }));
+}
@@ -0,0 +1,134 @@
+#include "regions.h"
+#include "log.h"
+#include <algorithm>
+#include <sstream>
+#include <opencv2/imgproc.hpp>
+
+std::vector<Region> ParseRegions(const std::string& spec) {
+    std::vector<Region> regions;
+    std::stringstream polygons(spec);
+    std::string polygon;
+
+    while (std::getline(polygons, polygon, ';')) {
+        Region region;
+        std::stringstream points(polygon);
+        std::string point;
+        bool valid = true;
+
+        while (points >> point) {
+            size_t comma = point.find(',');
+            if (comma == std::string::npos) {
+                valid = false;
+                break;
+            }
+            try {
+                float x = std::stof(point.substr(0, comma));
+                float y = std::stof(point.substr(comma + 1));
+                region.emplace_back(std::clamp(x, 0.0f, 1.0f), std::clamp(y, 0.0f, 1.0f));
+            } catch (const std::exception&) {
+                valid = false;
+                break;
+            }
+        }
+
+        if (!valid || region.size() < 3) {
+            if (!polygon.empty()) {
+                WARN_LOG("Ignoring invalid region: " + polygon);
+            }
+            continue;
+        }
+        regions.push_back(std::move(region));
+    }
+
+    return regions;
+}
+
+std::vector<cv::Point> RegionToPixels(const Region& region, const cv::Size& size) {
+    std::vector<cv::Point> pixels;
+    pixels.reserve(region.size());
+    for (const auto& point : region) {
+        pixels.emplace_back(cvRound(point.x * (size.width - 1)), cvRound(point.y * (size.height - 1)));
+    }
+    return pixels;
+}
+
+cv::Mat RegionMask(const std::vector<Region>& regions, const cv::Size& size) {
+    if (regions.empty()) {
+        return cv::Mat(size, CV_8UC1, cv::Scalar(255));
+    }
+
+    cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+    std::vector<std::vector<cv::Point>> polygons;
+    for (const auto& region : regions) {
+        polygons.push_back(RegionToPixels(region, size));
+    }
+    cv::fillPoly(mask, polygons, cv::Scalar(255));
+    return mask;
+}
+
+cv::Rect RegionBounds(const Region& region, const cv::Size& size) {
+    return cv::boundingRect(RegionToPixels(region, size)) & cv::Rect(cv::Point(0, 0), size);
+}
+
+bool RegionsContain(const std::vector<Region>& regions, const cv::Size& size, const cv::Point& point) {
+    if (regions.empty()) {
+        return true;
+    }
+
+    for (const auto& region : regions) {
+        if (cv::pointPolygonTest(RegionToPixels(region, size), cv::Point2f(point), false) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Evenly spaced tile offsets along one axis, first and last flush with the ends
+std::vector<int> TileOffsets(int start, int length, int tile, float overlap) {
+    if (length <= tile) {
+        return {start};
+    }
+
+    int stride = std::max(1, static_cast<int>(tile * (1.0f - overlap)));
+    int count = (length - tile + stride - 1) / stride + 1;
+    std::vector<int> offsets;
+    offsets.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        offsets.push_back(start + static_cast<int>(static_cast<int64_t>(length - tile) * i / (count - 1)));
+    }
+    return offsets;
+}
+
+}  // namespace
+
+std::vector<cv::Rect> TileArea(const cv::Rect& area, cv::Size tile, float overlap, int max_tiles) {
+    if (area.empty() || tile.empty()) {
+        return {};
+    }
+    overlap = std::clamp(overlap, 0.0f, 0.9f);
+    max_tiles = std::max(1, max_tiles);
+
+    std::vector<int> xs;
+    std::vector<int> ys;
+    while (true) {
+        xs = TileOffsets(area.x, area.width, tile.width, overlap);
+        ys = TileOffsets(area.y, area.height, tile.height, overlap);
+        if (static_cast<int>(xs.size() * ys.size()) <= max_tiles) {
+            break;
+        }
+        // Fewer, larger tiles that the model will downscale
+        tile.width = tile.width * 5 / 4 + 1;
+        tile.height = tile.height * 5 / 4 + 1;
+    }
+
+    std::vector<cv::Rect> tiles;
+    tiles.reserve(xs.size() * ys.size());
+    for (int y : ys) {
+        for (int x : xs) {
+            tiles.push_back(cv::Rect(x, y, tile.width, tile.height) & area);
+        }
+    }
+    return tiles;
+}
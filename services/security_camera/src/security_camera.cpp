@@ -8,12 +8,6 @@
 #include <ctime>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
 #include <random>
 #include <algorithm>
 
@@ -24,23 +18,170 @@ SecurityCamera::SecurityCamera(const std::string& broker_address, const std::str
     
     // Get environment variables
     int camera_id = 0;
+    std::string camera_ids;
     int width = 640;
     int height = 480;
     int fps = 15;
+    std::string backend = "opencv";
+    std::string pixel_format = "yuyv";
     
     GetEnvVar("CAMERA_ID", camera_id);
+    GetEnvVar("CAMERA_IDS", camera_ids);
     GetEnvVar("FRAME_WIDTH", width);
     GetEnvVar("FRAME_HEIGHT", height);
     GetEnvVar("FPS_TARGET", fps);
+    GetEnvVar("CAMERA_BACKEND", backend);
+    GetEnvVar("CAMERA_PIXEL_FORMAT", pixel_format);
     
     // Get SSL certificate and key paths
     GetEnvVar("HTTPS_CERT_PATH", cert_file_);
     GetEnvVar("HTTPS_KEY_PATH", key_file_);
     GetEnvVar("HTTPS_ENABLED", use_https_);
     
-    // Initialize camera with settings
-    camera_capture_ = std::make_unique<CameraCapture>(camera_id, width, height, fps);
-    frame_processor_ = std::make_unique<FrameProcessor>();
+    std::string snapshot_mode = "json";
+    GetEnvVar("SNAPSHOT_MODE", snapshot_mode);
+    binary_snapshots_ = snapshot_mode == "binary";
+    
+    // Camera settings shared by every camera
+    CameraConfig camera_config;
+    camera_config.width = width;
+    camera_config.height = height;
+    camera_config.fps = fps;
+    camera_config.backend = backend == "v4l2" ? CaptureBackend::V4L2 : CaptureBackend::OPENCV;
+    camera_config.mjpeg = pixel_format == "mjpeg";
+    
+    // CAMERA_SOURCE replaces the device with generated or recorded frames:
+    // "pattern", a directory of images or a video file
+    if (GetEnvVar("CAMERA_SOURCE", camera_config.source) && !camera_config.source.empty()) {
+        camera_config.backend = CaptureBackend::SOURCE;
+    }
+    
+    // Motion gating settings, threshold is the percentage of the watched area that must change
+    double motion_threshold = 1.0;
+    std::string motion_regions;
+    GetEnvVar("MOTION_ENABLED", camera_config.motion_enabled);
+    GetEnvVar("MOTION_THRESHOLD", motion_threshold);
+    GetEnvVar("MOTION_HOLD_MS", camera_config.motion_hold_ms);
+    GetEnvVar("MOTION_REGIONS", motion_regions);
+    camera_config.motion_threshold = motion_threshold / 100.0;
+    camera_config.motion_regions = ParseRegions(motion_regions);
+    
+    // Inference regions, DETECTION_REGIONS_<camera id> overrides DETECTION_REGIONS per camera
+    std::string detection_regions;
+    double tile_overlap = camera_config.inference.tile_overlap;
+    GetEnvVar("DETECTION_REGIONS", detection_regions);
+    GetEnvVar("DETECTION_TILING", camera_config.inference.tile);
+    if (GetEnvVar("DETECTION_TILE_OVERLAP", tile_overlap)) {
+        camera_config.inference.tile_overlap = static_cast<float>(tile_overlap);
+    }
+    GetEnvVar("DETECTION_MAX_TILES", camera_config.inference.max_tiles);
+    camera_config.inference.regions = ParseRegions(detection_regions);
+    
+    // Object tracking turns per-frame detections into enter/update/exit events
+    double track_iou = camera_config.tracker.iou_threshold;
+    if (GetEnvVar("TRACK_IOU_THRESHOLD", track_iou)) {
+        camera_config.tracker.iou_threshold = static_cast<float>(track_iou);
+    }
+    GetEnvVar("TRACK_MIN_HITS", camera_config.tracker.min_hits);
+    GetEnvVar("TRACK_MAX_AGE_MS", camera_config.tracker.max_age_ms);
+    GetEnvVar("TRACK_MAX_MISSED", camera_config.tracker.max_missed);
+    GetEnvVar("TRACK_MOVING_HOLD_MS", camera_config.tracker.moving_hold_ms);
+    GetEnvVar("TRACK_UPDATE_INTERVAL_MS", camera_config.tracker.update_interval_ms);
+    GetEnvVar("SNAPSHOT_INTERVAL_MS", camera_config.tracker.snapshot_interval_ms);
+    GetEnvVar("PUBLISH_RAW_DETECTIONS", publish_raw_detections_);
+    
+    // Event clips with pre-roll, triggered by tracked objects
+    int clip_budget_mb = static_cast<int>(camera_config.clips.memory_budget_bytes / (1024 * 1024));
+    GetEnvVar("CLIP_ENABLED", camera_config.clips.enabled);
+    GetEnvVar("CLIP_DIR", camera_config.clips.directory);
+    GetEnvVar("CLIP_FPS", camera_config.clips.fps);
+    GetEnvVar("CLIP_PRE_EVENT_S", camera_config.clips.pre_event_s);
+    GetEnvVar("CLIP_POST_EVENT_S", camera_config.clips.post_event_s);
+    GetEnvVar("CLIP_MAX_S", camera_config.clips.max_clip_s);
+    if (GetEnvVar("CLIP_MEMORY_MB", clip_budget_mb)) {
+        camera_config.clips.memory_budget_bytes = static_cast<size_t>(std::max(1, clip_budget_mb)) * 1024 * 1024;
+    }
+    
+    // CAMERA_IDS lists several devices, CAMERA_ID is used when it is not set
+    std::vector<int> devices;
+    std::stringstream camera_list(camera_ids);
+    std::string device;
+    while (std::getline(camera_list, device, ',')) {
+        try {
+            devices.push_back(std::stoi(device));
+        } catch (const std::exception& e) {
+            ERROR_LOG("Invalid camera id in CAMERA_IDS: " + device);
+        }
+    }
+    if (devices.empty()) {
+        devices.push_back(camera_id);
+    }
+    
+    // Detection model, a preset name whose paths and input size can be overridden
+    std::string model_name = "yolov3";
+    GetEnvVar("DETECTION_MODEL", model_name);
+    ModelConfig model_config = ModelConfig::FromName(model_name);
+    GetEnvVar("DETECTION_MODEL_PATH", model_config.model_path);
+    GetEnvVar("DETECTION_MODEL_CONFIG", model_config.config_path);
+    GetEnvVar("DETECTION_MODEL_CLASSES", model_config.classes_path);
+    GetEnvVar("DETECTION_INPUT_WIDTH", model_config.input_size.width);
+    GetEnvVar("DETECTION_INPUT_HEIGHT", model_config.input_size.height);
+    double nms_threshold = model_config.nms_threshold;
+    if (GetEnvVar("DETECTION_NMS_THRESHOLD", nms_threshold)) {
+        model_config.nms_threshold = static_cast<float>(nms_threshold);
+    }
+    std::string detection_classes;
+    if (GetEnvVar("DETECTION_CLASSES", detection_classes)) {
+        model_config.allowed_classes.clear();
+        std::stringstream ss(detection_classes);
+        std::string name;
+        while (std::getline(ss, name, ',')) {
+            if (!name.empty()) {
+                model_config.allowed_classes.push_back(name);
+            }
+        }
+    }
+    
+    // Inference is shared, by default a batch holds one frame from each camera
+    int batch_size = static_cast<int>(devices.size());
+    int queue_depth = 2;
+    int inference_threads = 1;
+    GetEnvVar("INFERENCE_BATCH_SIZE", batch_size);
+    GetEnvVar("INFERENCE_QUEUE_DEPTH", queue_depth);
+    GetEnvVar("INFERENCE_THREADS", inference_threads);
+    
+    // Detection rate per camera, bounded by the cores inference may keep busy
+    SchedulerConfig schedule;
+    GetEnvVar("INFERENCE_CPU_BUDGET", schedule.cpu_budget);
+    GetEnvVar("INFERENCE_ACTIVE_FPS", schedule.active_fps);
+    GetEnvVar("INFERENCE_IDLE_FPS", schedule.idle_fps);
+    inference_pool_ = std::make_unique<InferencePool>(
+        model_config, devices.size(), std::max(1, batch_size), std::max(1, queue_depth), inference_threads,
+        schedule);
+    
+    // Initialize cameras with settings
+    for (int camera_device : devices) {
+        CameraConfig config = camera_config;
+        config.device = camera_device;
+        config.id = std::to_string(camera_device);
+        std::string camera_regions;
+        if (GetEnvVar("DETECTION_REGIONS_" + config.id, camera_regions)) {
+            config.inference.regions = ParseRegions(camera_regions);
+        }
+        cameras_.push_back(std::make_unique<CameraPipeline>(
+            cameras_.size(), config, *inference_pool_,
+            [this]() {
+                if (stream_server_) {
+                    stream_server_->NotifyFrame();
+                }
+            },
+            [this](size_t camera, bool motion, double score) {
+                PublishMotion(cameras_[camera]->Id(), motion, score);
+            },
+            [this](const json& clip) {
+                Publish(CLIPS_TOPIC, clip);
+            }));
+    }
 
     // Set up MQTT message callback
     SetMessageCallback([this](mqtt::const_message_ptr msg) {
@@ -57,11 +198,23 @@ SecurityCamera::SecurityCamera(const std::string& broker_address, const std::str
             use_https_ = false;
         }
     }
+
+    int stream_threads = 2;
+    GetEnvVar("STREAM_THREADS", stream_threads);
+    std::vector<StreamSource> stream_sources;
+    for (auto& camera : cameras_) {
+        stream_sources.push_back({camera->Id(), &camera->Broadcaster()});
+    }
+    stream_server_ = std::make_unique<StreamServer>(
+        std::move(stream_sources), use_https_ ? ssl_ctx_ : nullptr,
+        [this](const std::string& token) { return ValidateToken(token); },
+        stream_threads);
 }
 
 SecurityCamera::~SecurityCamera() {
     DEBUG_LOG("SecurityCamera destructor called");
     Stop();
+    stream_server_.reset();
     
     // Cleanup SSL
     if (ssl_ctx_) {
@@ -73,15 +226,16 @@ void SecurityCamera::Initialize() {
     INFO_LOG("Initializing Security Camera Service");
     
     try {
-        // Initialize camera first
-        if (!camera_capture_->Initialize()) {
-            ERROR_LOG("Failed to initialize camera");
-            throw std::runtime_error("Failed to initialize camera");
+        // Initialize cameras first
+        for (auto& camera : cameras_) {
+            if (!camera->Initialize()) {
+                throw std::runtime_error("Failed to initialize camera " + camera->Id());
+            }
         }
-        INFO_LOG("Camera initialized successfully");
+        INFO_LOG("Initialized " + std::to_string(cameras_.size()) + " camera(s)");
         
-        // Initialize frame processor
-        if (!frame_processor_->Initialize()) {
+        // Initialize the shared detector
+        if (!inference_pool_->Initialize()) {
             ERROR_LOG("Failed to initialize frame processor");
             throw std::runtime_error("Failed to initialize frame processor");
         }
@@ -94,8 +248,12 @@ void SecurityCamera::Initialize() {
         }
         
         // Only start threads after successful initialization
-        capture_thread_ = std::thread(&SecurityCamera::CaptureLoop, this);
-        processing_thread_ = std::thread(&SecurityCamera::ProcessingLoop, this);
+        inference_pool_->Start([this](size_t camera, const cv::Mat& frame, const DetectionResult& result) {
+            HandleDetections(camera, frame, result);
+        });
+        for (auto& camera : cameras_) {
+            camera->Start();
+        }
         worker_thread_ = std::thread(&SecurityCamera::Run, this);
         
         INFO_LOG("Security Camera Service initialized successfully");
@@ -120,26 +278,19 @@ void SecurityCamera::Stop() {
     running_ = false;
     
     // Notify all waiting threads
-    frame_queue_cv_.notify_all();
     command_queue_cv_.notify_all();
     
-    // Wait for threads to finish
-    if (capture_thread_.joinable()) {
-        capture_thread_.join();
-        DEBUG_LOG("Capture thread joined");
+    // Wait for threads to finish, capture first so nothing new reaches the detector
+    for (auto& camera : cameras_) {
+        camera->Stop();
     }
-    if (processing_thread_.joinable()) {
-        processing_thread_.join();
-        DEBUG_LOG("Processing thread joined");
+    if (inference_pool_) {
+        inference_pool_->Stop();
     }
     if (worker_thread_.joinable()) {
         worker_thread_.join();
         DEBUG_LOG("Worker thread joined");
     }
-    if (stream_server_thread_.joinable()) {
-        stream_server_thread_.join();
-        DEBUG_LOG("Stream server thread joined");
-    }
     
     try {
         // Publish offline status
@@ -170,9 +321,16 @@ void SecurityCamera::Run() {
             } catch (const std::exception& e) {
                 ERROR_LOG("Exception in status update: " + std::string(e.what()));
             }
+            CleanupExpiredTokens();
             last_status_time = now;
         }
 
+        // Tracks stop receiving frames when the motion gate closes, age them out here
+        for (auto& camera : cameras_) {
+            std::lock_guard<std::mutex> lock(camera->TrackingMutex());
+            PublishTrackerOutput(camera->Index(), camera->Tracker().Expire(), nullptr);
+        }
+
         // Process any pending commands
         json command;
         bool has_command = false;
@@ -206,18 +364,16 @@ void SecurityCamera::ProcessCommand(const json& command) {
         std::string action = command["action"];
         DEBUG_LOG("Processing action: " + action);
         
+        std::vector<CameraPipeline*> cameras = SelectCameras(command);
+        
         if (action == "snapshot") {
-            cv::Mat frame;
-            {
-                std::lock_guard<std::mutex> lock(frame_queue_mutex_);
-                if (!frame_queue_.empty()) {
-                    frame = frame_queue_.front();
+            for (auto* camera : cameras) {
+                cv::Mat frame = camera->LatestFrame();
+                
+                if (!frame.empty()) {
+                    PublishSnapshot(frame, camera->Id());
                 }
             }
-            
-            if (!frame.empty()) {
-                PublishSnapshot(frame);
-            }
         }
         else if (action == "start_stream") {
             if (!streaming_) {
@@ -249,22 +405,39 @@ void SecurityCamera::ProcessCommand(const json& command) {
             INFO_LOG("New stream token generated");
         }
         else if (action == "night_mode_on") {
-            camera_capture_->SetNightMode(true);
-            INFO_LOG("Night mode enabled");
+            for (auto* camera : cameras) {
+                camera->Capture().SetNightMode(true);
+                INFO_LOG("Night mode enabled on camera " + camera->Id());
+            }
         }
         else if (action == "night_mode_off") {
-            camera_capture_->SetNightMode(false);
-            INFO_LOG("Night mode disabled");
+            for (auto* camera : cameras) {
+                camera->Capture().SetNightMode(false);
+                INFO_LOG("Night mode disabled on camera " + camera->Id());
+            }
         }
         else if (action == "set_night_mode_threshold") {
             if (command.contains("threshold") && command["threshold"].is_number()) {
                 int threshold = command["threshold"];
-                camera_capture_->SetNightModeThreshold(threshold);
+                for (auto* camera : cameras) {
+                    camera->Capture().SetNightModeThreshold(threshold);
+                }
                 INFO_LOG("Night mode threshold set to " + std::to_string(threshold));
             } else {
                 ERROR_LOG("Missing or invalid 'threshold' field for set_night_mode_threshold action");
             }
         }
+        else if (action == "set_motion_threshold") {
+            if (command.contains("threshold") && command["threshold"].is_number()) {
+                double threshold = command["threshold"];
+                for (auto* camera : cameras) {
+                    camera->SetMotionThreshold(threshold / 100.0);
+                }
+                INFO_LOG("Motion threshold set to " + std::to_string(threshold) + "%");
+            } else {
+                ERROR_LOG("Missing or invalid 'threshold' field for set_motion_threshold action");
+            }
+        }
         else {
             ERROR_LOG("Unknown action: " + action);
         }
@@ -274,84 +447,59 @@ void SecurityCamera::ProcessCommand(const json& command) {
     }
 }
 
-void SecurityCamera::CaptureLoop() {
-    INFO_LOG("Capture thread started");
+std::vector<CameraPipeline*> SecurityCamera::SelectCameras(const json& command) {
+    std::vector<CameraPipeline*> selected;
+    std::string camera_id;
+    if (command.contains("camera")) {
+        camera_id = command["camera"].is_string() ? command["camera"].get<std::string>()
+                                                  : command["camera"].dump();
+    }
     
-    while (running_) {
-        try {
-            // Capture frame
-            cv::Mat frame = camera_capture_->CaptureFrame();
-            
-            if (frame.empty()) {
-                WARN_LOG("Empty frame captured");
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                continue;
-            }
-            
-            // Store latest frame for streaming
-            if (streaming_) {
-                std::lock_guard<std::mutex> lock(latest_frame_mutex_);
-                frame.copyTo(latest_frame_);
-            }
-            
-            // Add frame to queue for processing
-            {
-                std::lock_guard<std::mutex> lock(frame_queue_mutex_);
-                
-                // If queue is getting too large, remove oldest frames
-                while (frame_queue_.size() > 5) {
-                    frame_queue_.pop();
-                }
-                
-                frame_queue_.push(frame);
-            }
-            
-            // Notify processing thread
-            frame_queue_cv_.notify_one();
-            
-            // Sleep to maintain desired frame rate
-            std::this_thread::sleep_for(std::chrono::milliseconds(33)); // ~30 FPS
-        } catch (const std::exception& e) {
-            ERROR_LOG("Error in capture loop: " + std::string(e.what()));
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    for (auto& camera : cameras_) {
+        if (camera_id.empty() || camera->Id() == camera_id) {
+            selected.push_back(camera.get());
         }
     }
-    
-    INFO_LOG("Capture thread stopped");
+    if (selected.empty()) {
+        ERROR_LOG("Unknown camera: " + camera_id);
+    }
+    return selected;
 }
 
-void SecurityCamera::ProcessingLoop() {
-    INFO_LOG("Processing thread started");
-    
-    while (running_) {
-        cv::Mat frame;
-        {
-            std::unique_lock<std::mutex> lock(frame_queue_mutex_);
-            frame_queue_cv_.wait(lock, [this] { 
-                return !frame_queue_.empty() || !running_; 
-            });
-            
-            if (!running_) break;
-            
-            frame = frame_queue_.front();
-            frame_queue_.pop();
+void SecurityCamera::HandleDetections(size_t camera, const cv::Mat& frame, const DetectionResult& result) {
+    // Empty results are tracked too, they keep tracks alive and age them out
+    std::lock_guard<std::mutex> lock(cameras_[camera]->TrackingMutex());
+    TrackerOutput output = cameras_[camera]->Tracker().Update(result.detections, frame, result.captured);
+    if (output.stale) {
+        DEBUG_LOG("Dropping out of order detections for camera " + cameras_[camera]->Id());
+        return;
+    }
+    PublishTrackerOutput(camera, output, &result);
+}
+
+void SecurityCamera::PublishTrackerOutput(size_t camera, const TrackerOutput& output, const DetectionResult* result) {
+    const std::string& camera_id = cameras_[camera]->Id();
+    bool has_detections = result && !result->detections.empty();
+
+    // New objects start a clip, any object still in view keeps it recording
+    ClipRecorder& recorder = cameras_[camera]->Recorder();
+    for (const auto& event : output.events) {
+        if (event.type == TrackEventType::ENTER) {
+            recorder.Trigger(event.ToJson());
         }
+    }
+    if (cameras_[camera]->Tracker().ActiveTracks() > 0) {
+        recorder.Extend();
+    }
+
+    if (!output.events.empty() || (publish_raw_detections_ && has_detections)) {
+        // Group detections by type
+        int person_count = 0;
+        int vehicle_count = 0;
+        int animal_count = 0;
         
-        if (!frame.empty()) {
-            // Process frame and get detections
-            auto result = frame_processor_->ProcessFrame(frame);
-            
-            // Publish detections
-            json details;
-            details["fps"] = result.fps;
-            details["latency_ms"] = result.latency_ms;
-            
-            // Group detections by type
-            int person_count = 0;
-            int vehicle_count = 0;
-            int animal_count = 0;
-            
-            for (const auto& det : result.detections) {
+        if (result) {
+            for (const auto& det : result->detections) {
                 if (det.class_name == "person") {
                     person_count++;
                 } else if (det.class_name == "car" || det.class_name == "truck" || 
@@ -361,23 +509,32 @@ void SecurityCamera::ProcessingLoop() {
                     animal_count++;
                 }
             }
-            
-            // Publish detection results
-            if (!result.detections.empty()) {
-                json detection_details = result.ToJson();
-                detection_details["person_count"] = person_count;
-                detection_details["vehicle_count"] = vehicle_count;
-                detection_details["animal_count"] = animal_count;
-                
-                Publish(DETECTIONS_TOPIC, detection_details);
-                
-                // Also publish snapshot if something was detected
-                PublishSnapshot(frame);
-            }
         }
+        
+        // Publish detection results, expiry only reports the events
+        json detection_details = result ? result->ToJson() : json{{"detections", json::array()}};
+        detection_details["camera"] = camera_id;
+        detection_details["person_count"] = person_count;
+        detection_details["vehicle_count"] = vehicle_count;
+        detection_details["animal_count"] = animal_count;
+        json events = json::array();
+        for (const auto& event : output.events) {
+            events.push_back(event.ToJson());
+        }
+        detection_details["events"] = events;
+        detection_details["active_tracks"] = cameras_[camera]->Tracker().ActiveTracks();
+        
+        Publish(DETECTIONS_TOPIC, detection_details);
     }
     
-    INFO_LOG("Processing thread stopped");
+    // At most one snapshot per track per interval, showing its best frame
+    for (const auto& snapshot : output.snapshots) {
+        PublishSnapshot(snapshot.frame, camera_id, {
+            {"track_id", snapshot.track_id},
+            {"class", snapshot.class_name},
+            {"confidence", snapshot.confidence}
+        });
+    }
 }
 
 void SecurityCamera::IncomingMessage(const std::string& topic, const std::string& payload) {
@@ -399,37 +556,90 @@ void SecurityCamera::PublishStatus(const std::string& status) {
     payload["status"] = status;
     payload["timestamp"] = std::time(nullptr);
     
-    // Add night mode information
-    if (camera_capture_) {
-        payload["night_mode"] = camera_capture_->IsNightMode();
-        payload["night_mode_threshold"] = camera_capture_->GetNightModeThreshold();
+    // Per camera state, the first camera is also reported at the top level
+    bool motion = false;
+    json cameras = json::array();
+    for (auto& camera : cameras_) {
+        json camera_status;
+        camera_status["camera"] = camera->Id();
+        camera_status["night_mode"] = camera->Capture().IsNightMode();
+        camera_status["night_mode_threshold"] = camera->Capture().GetNightModeThreshold();
+        camera_status["motion"] = camera->IsMotionActive();
+        camera_status["dropped_frames"] = inference_pool_->DroppedFrames(camera->Index());
+        camera_status["inference_fps"] = inference_pool_->Scheduler().Rate(camera->Index());
+        camera_status["active_tracks"] = camera->Tracker().ActiveTracks();
+        if (camera->Recorder().Enabled()) {
+            camera_status["clips"] = camera->Recorder().Metrics();
+        }
+        cameras.push_back(camera_status);
+        motion = motion || camera->IsMotionActive();
+    }
+    if (!cameras_.empty()) {
+        payload["night_mode"] = cameras_.front()->Capture().IsNightMode();
+        payload["night_mode_threshold"] = cameras_.front()->Capture().GetNightModeThreshold();
+    }
+    payload["motion"] = motion;
+    payload["cameras"] = cameras;
+    if (inference_pool_) {
+        payload["inference"] = inference_pool_->Scheduler().Metrics();
     }
     
     Publish(STATUS_TOPIC, payload);
 }
 
-void SecurityCamera::PublishSnapshot(const cv::Mat& frame) {
-    // Convert frame to base64
-    std::string base64_image = MatToBase64(frame);
-    
+void SecurityCamera::PublishMotion(const std::string& camera, bool motion, double score) {
     json payload;
-    payload["image"] = base64_image;
+    payload["camera"] = camera;
+    payload["motion"] = motion;
+    payload["score"] = score * 100.0;
     payload["timestamp"] = std::time(nullptr);
+    
+    Publish(MOTION_TOPIC, payload);
+}
 
+void SecurityCamera::PublishSnapshot(const cv::Mat& frame, const std::string& camera, const json& extra) {
+    json payload = extra;
+    payload["camera"] = camera;
+    payload["timestamp"] = std::time(nullptr);
     payload["width"] = frame.cols;
     payload["height"] = frame.rows;
+
+    if (binary_snapshots_) {
+        std::vector<uchar> jpeg;
+        if (!EncodeJpeg(frame, jpeg)) {
+            return;
+        }
+        // The image goes first, the sequence pairs it with its metadata
+        std::string image_topic = std::string(SNAPSHOT_IMAGE_TOPIC_PREFIX) + camera;
+        PublishBinary(image_topic, jpeg.data(), jpeg.size());
+
+        payload["sequence"] = ++snapshot_sequence_;
+        payload["format"] = "jpeg";
+        payload["bytes"] = jpeg.size();
+        payload["image_topic"] = image_topic;
+    } else {
+        payload["image"] = MatToBase64(frame);
+    }
     
     Publish(SNAPSHOT_TOPIC, payload);
 }
 
-std::string SecurityCamera::MatToBase64(const cv::Mat& image) {
+bool SecurityCamera::EncodeJpeg(const cv::Mat& image, std::vector<uchar>& buffer) {
     // Compress the image with lower quality for faster processing
     std::vector<int> compression_params;
     compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
     compression_params.push_back(80); // Lower quality for faster processing
     
+    if (!cv::imencode(".jpg", image, buffer, compression_params)) {
+        ERROR_LOG("Failed to encode snapshot");
+        return false;
+    }
+    return true;
+}
+
+std::string SecurityCamera::MatToBase64(const cv::Mat& image) {
     std::vector<uchar> buffer;
-    cv::imencode(".jpg", image, buffer, compression_params);
+    EncodeJpeg(image, buffer);
     
     std::string base64_image = "data:image/jpeg;base64,";
     
@@ -503,12 +713,32 @@ bool SecurityCamera::GetEnvVar(const std::string& name, int& value) {
     return false;
 }
 
+bool SecurityCamera::GetEnvVar(const std::string& name, double& value) {
+    std::string str_value;
+    if (GetEnvVar(name, str_value)) {
+        try {
+            value = std::stod(str_value);
+            return true;
+        } catch (const std::exception& e) {
+            ERROR_LOG("Error converting environment variable " + name + " to double: " + e.what());
+        }
+    }
+    return false;
+}
+
 void SecurityCamera::PublishStreamInfo(bool streaming, const std::string& url) {
     json payload;
     payload["streaming"] = streaming;
     if (streaming && !url.empty()) {
         payload["url"] = url;
         payload["requires_token"] = true;
+        
+        // Append &camera=<id> to pick a camera, the first one is served by default
+        json cameras = json::array();
+        for (auto& camera : cameras_) {
+            cameras.push_back(camera->Id());
+        }
+        payload["cameras"] = cameras;
     }
     payload["timestamp"] = std::time(nullptr);
     
@@ -529,14 +759,15 @@ bool SecurityCamera::StartStreaming() {
     }
     
     try {
-        // Set flag before starting thread
+        // Bind and start the reactors before advertising the stream
+        int port = stream_port_.load();
+        if (!stream_server_->Start(port)) {
+            return false;
+        }
         streaming_ = true;
-        
-        // Create stream server thread
-        stream_server_thread_ = std::thread(&SecurityCamera::StreamServerLoop, this);
-        
-        // Wait a bit for the server to start
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        for (auto& camera : cameras_) {
+            camera->SetStreaming(true);
+        }
         
         // Get local IP address
         std::string host_ip = "localhost"; // Default fallback
@@ -548,7 +779,6 @@ bool SecurityCamera::StartStreaming() {
         }
         
         // Construct stream URL
-        int port = stream_port_.load();
         std::string protocol = use_https_ ? "https" : "http";
         stream_url_ = protocol + "://" + host_ip + ":" + std::to_string(port) + "/stream?token=TOKEN";
         
@@ -559,6 +789,10 @@ bool SecurityCamera::StartStreaming() {
     } catch (const std::exception& e) {
         ERROR_LOG("Error starting stream: " + std::string(e.what()));
         streaming_ = false;
+        for (auto& camera : cameras_) {
+            camera->SetStreaming(false);
+        }
+        stream_server_->Stop();
         return false;
     }
 }
@@ -568,333 +802,17 @@ void SecurityCamera::StopStreaming() {
         return; // Not streaming
     }
     
-    // Set streaming flag to false first to signal all threads to stop
+    // Stop publishing frames, then close the server and all client connections
     streaming_ = false;
-    
-    // Give client threads a moment to notice the streaming flag change
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    
-    // Close all client connections
-    {
-        std::lock_guard<std::mutex> lock(stream_clients_mutex_);
-        for (const auto& client : stream_clients_) {
-            try {
-                if (use_https_ && client.ssl) {
-                    SSL_shutdown(client.ssl);
-                    SSL_free(client.ssl);
-                }
-                close(client.socket);
-            } catch (const std::exception& e) {
-                ERROR_LOG("Error closing client connection: " + std::string(e.what()));
-            }
-        }
-        stream_clients_.clear();
-    }
-    
-    // Wait for stream server thread to finish
-    if (stream_server_thread_.joinable()) {
-        try {
-            stream_server_thread_.join();
-        } catch (const std::exception& e) {
-            ERROR_LOG("Error joining stream server thread: " + std::string(e.what()));
-        }
+    for (auto& camera : cameras_) {
+        camera->SetStreaming(false);
     }
+    stream_server_->Stop();
     
     // Publish stream info
     PublishStreamInfo(false);
 }
 
-void SecurityCamera::StreamServerLoop() {
-    int port = stream_port_.load();
-    INFO_LOG("Starting " + std::string(use_https_ ? "HTTPS" : "HTTP") + " stream server on port " + std::to_string(port));
-    
-    int server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket < 0) {
-        ERROR_LOG("Failed to create socket");
-        streaming_ = false;
-        return;
-    }
-    
-    // Set socket options to allow reuse of address
-    int opt = 1;
-    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        ERROR_LOG("Failed to set socket options");
-        close(server_socket);
-        streaming_ = false;
-        return;
-    }
-    
-    // Set up server address
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(port);
-    
-    // Bind socket
-    if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        ERROR_LOG("Failed to bind socket");
-        close(server_socket);
-        streaming_ = false;
-        return;
-    }
-    
-    // Listen for connections
-    if (listen(server_socket, 5) < 0) {
-        ERROR_LOG("Failed to listen on socket");
-        close(server_socket);
-        streaming_ = false;
-        return;
-    }
-    
-    // Set socket to non-blocking mode
-    int flags = fcntl(server_socket, F_GETFL, 0);
-    fcntl(server_socket, F_SETFL, flags | O_NONBLOCK);
-    
-    INFO_LOG("MJPEG stream server started");
-    
-    // Accept connections and handle clients
-    while (streaming_ && running_) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        
-        int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
-        
-        if (client_socket >= 0) {
-            // Got a new client
-            INFO_LOG("New streaming client connected: " + 
-                     std::string(inet_ntoa(client_addr.sin_addr)) + ":" + 
-                     std::to_string(ntohs(client_addr.sin_port)));
-            
-            // Handle client in a separate thread
-            std::thread client_thread(&SecurityCamera::HandleStreamClient, this, client_socket);
-            client_thread.detach(); // Let it run independently
-        }
-        
-        // Clean up expired tokens periodically
-        CleanupExpiredTokens();
-        
-        // Sleep to avoid busy waiting
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-    
-    // Close server socket
-    close(server_socket);
-    
-    INFO_LOG("MJPEG stream server stopped");
-}
-
-void SecurityCamera::HandleStreamClient(int client_socket) {
-    SSL* ssl = nullptr;
-    bool client_added_to_list = false;
-    
-    try {
-        // Set up SSL if HTTPS is enabled
-        if (use_https_ && ssl_ctx_) {
-            ssl = SSL_new(ssl_ctx_);
-            if (!ssl) {
-                throw std::runtime_error("Failed to create SSL structure");
-            }
-            
-            SSL_set_fd(ssl, client_socket);
-            
-            if (SSL_accept(ssl) <= 0) {
-                throw std::runtime_error("SSL handshake failed");
-            }
-            
-            INFO_LOG("SSL connection established");
-        }
-        
-        // Read HTTP request
-        char buffer[4096] = {0};
-        int bytes_read;
-        
-        if (use_https_ && ssl) {
-            bytes_read = SSL_read(ssl, buffer, sizeof(buffer) - 1);
-        } else {
-            bytes_read = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-        }
-        
-        if (bytes_read <= 0) {
-            throw std::runtime_error("Failed to read HTTP request");
-        }
-        
-        buffer[bytes_read] = '\0';
-        std::string request(buffer);
-        
-        // Parse HTTP request
-        std::map<std::string, std::string> headers;
-        std::string path;
-        if (!ParseHttpRequest(request, headers, path)) {
-            throw std::runtime_error("Invalid HTTP request");
-        }
-        
-        // Extract token from query string
-        std::string token;
-        size_t token_pos = path.find("token=");
-        if (token_pos != std::string::npos) {
-            token = path.substr(token_pos + 6);
-            size_t end_pos = token.find('&');
-            if (end_pos != std::string::npos) {
-                token = token.substr(0, end_pos);
-            }
-        }
-        
-        // Validate token
-        if (!ValidateToken(token)) {
-            // Send 401 Unauthorized
-            std::string response = "HTTP/1.1 401 Unauthorized\r\n"
-                                  "Content-Type: text/plain\r\n"
-                                  "Connection: close\r\n\r\n"
-                                  "Invalid or expired token";
-            
-            if (use_https_ && ssl) {
-                SSL_write(ssl, response.c_str(), response.size());
-            } else {
-                send(client_socket, response.c_str(), response.size(), 0);
-            }
-            
-            throw std::runtime_error("Invalid token");
-        }
-        
-        // Add client to list
-        {
-            std::lock_guard<std::mutex> lock(stream_clients_mutex_);
-            stream_clients_.push_back({client_socket, ssl});
-            client_added_to_list = true;
-        }
-        
-        // Send HTTP response header
-        std::string header = "HTTP/1.1 200 OK\r\n"
-                            "Connection: close\r\n"
-                            "Cache-Control: no-cache\r\n"
-                            "Pragma: no-cache\r\n"
-                            "Content-Type: multipart/x-mixed-replace; boundary=mjpegstream\r\n\r\n";
-        
-        if (use_https_ && ssl) {
-            if (SSL_write(ssl, header.c_str(), header.size()) < 0) {
-                throw std::runtime_error("Failed to send HTTP header");
-            }
-        } else {
-            if (send(client_socket, header.c_str(), header.size(), 0) < 0) {
-                throw std::runtime_error("Failed to send HTTP header");
-            }
-        }
-        
-        // Stream frames until client disconnects or streaming stops
-        while (streaming_ && running_) {
-            // Get latest frame
-            cv::Mat frame;
-            {
-                std::lock_guard<std::mutex> lock(latest_frame_mutex_);
-                if (!latest_frame_.empty()) {
-                    frame = latest_frame_.clone();
-                }
-            }
-            
-            if (!frame.empty()) {
-                try {
-                    // Send frame to client
-                    SendMJPEGFrame(ssl, client_socket, frame);
-                } catch (const std::exception& e) {
-                    throw std::runtime_error("Error sending MJPEG frame: " + std::string(e.what()));
-                }
-            }
-            
-            // Sleep to maintain desired frame rate
-            std::this_thread::sleep_for(std::chrono::milliseconds(33)); // ~30 FPS
-        }
-    } catch (const std::exception& e) {
-        DEBUG_LOG("Client disconnected: " + std::string(e.what()));
-    }
-    
-    // Remove client from list if it was added
-    if (client_added_to_list) {
-        std::lock_guard<std::mutex> lock(stream_clients_mutex_);
-        auto it = std::find_if(stream_clients_.begin(), stream_clients_.end(),
-                              [client_socket](const ClientInfo& info) { return info.socket == client_socket; });
-        if (it != stream_clients_.end()) {
-            stream_clients_.erase(it);
-        }
-    }
-    
-    // Clean up SSL
-    if (use_https_ && ssl) {
-        try {
-            SSL_shutdown(ssl);
-            SSL_free(ssl);
-        } catch (...) {
-            // Ignore errors during cleanup
-        }
-    }
-    
-    // Close client socket
-    try {
-        close(client_socket);
-    } catch (...) {
-        // Ignore errors during cleanup
-    }
-}
-
-void SecurityCamera::SendMJPEGFrame(SSL* ssl, int client_socket, const cv::Mat& frame) {
-    try {
-        // Compress frame to JPEG
-        std::vector<uchar> buffer;
-        std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, 80}; // 80% quality
-        cv::imencode(".jpg", frame, buffer, params);
-        
-        // Create MJPEG frame header
-        std::stringstream header;
-        header << "--mjpegstream\r\n"
-               << "Content-Type: image/jpeg\r\n"
-               << "Content-Length: " << buffer.size() << "\r\n\r\n";
-        
-        std::string header_str = header.str();
-        
-        // Send header
-        int result = 0;
-        if (use_https_ && ssl) {
-            result = SSL_write(ssl, header_str.c_str(), header_str.size());
-            if (result < 0) {
-                throw std::runtime_error("Failed to send frame header");
-            }
-            
-            // Send image data
-            result = SSL_write(ssl, buffer.data(), buffer.size());
-            if (result < 0) {
-                throw std::runtime_error("Failed to send frame data");
-            }
-            
-            // Send boundary
-            std::string boundary = "\r\n";
-            result = SSL_write(ssl, boundary.c_str(), boundary.size());
-            if (result < 0) {
-                throw std::runtime_error("Failed to send frame boundary");
-            }
-        } else {
-            result = send(client_socket, header_str.c_str(), header_str.size(), 0);
-            if (result < 0) {
-                throw std::runtime_error("Failed to send frame header");
-            }
-            
-            // Send image data
-            result = send(client_socket, buffer.data(), buffer.size(), 0);
-            if (result < 0) {
-                throw std::runtime_error("Failed to send frame data");
-            }
-            
-            // Send boundary
-            std::string boundary = "\r\n";
-            result = send(client_socket, boundary.c_str(), boundary.size(), 0);
-            if (result < 0) {
-                throw std::runtime_error("Failed to send frame boundary");
-            }
-        }
-    } catch (const std::exception& e) {
-        throw std::runtime_error(std::string("Error sending MJPEG frame: ") + e.what());
-    }
-}
-
 std::string SecurityCamera::GenerateToken() {
     // Generate a random token
     const std::string chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -951,40 +869,6 @@ void SecurityCamera::CleanupExpiredTokens() {
     }
 }
 
-bool SecurityCamera::ParseHttpRequest(const std::string& request, std::map<std::string, std::string>& headers, std::string& path) {
-    std::istringstream stream(request);
-    std::string line;
-    
-    // Parse request line
-    if (!std::getline(stream, line)) {
-        return false;
-    }
-    
-    std::istringstream request_line(line);
-    std::string method, http_version;
-    
-    if (!(request_line >> method >> path >> http_version)) {
-        return false;
-    }
-    
-    // Parse headers
-    while (std::getline(stream, line) && line != "\r") {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string name = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
-            
-            // Trim whitespace
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of("\r\n") + 1);
-            
-            headers[name] = value;
-        }
-    }
-    
-    return true;
-}
-
 bool SecurityCamera::InitializeSSL() {
     // Initialize OpenSSL
     SSL_load_error_strings();
@@ -1027,6 +911,9 @@ bool SecurityCamera::InitializeSSL() {
         return false;
     }
     
+    // Stream sockets are non-blocking, allow partial writes and retries from the client write queues
+    SSL_CTX_set_mode(ssl_ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    
     INFO_LOG("SSL initialized successfully");
     return true;
 }
@@ -0,0 +1,703 @@
+#include "stream_server.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <openssl/err.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int MAX_EVENTS = 64;
+constexpr int EPOLL_TIMEOUT_MS = 1000;
+
+constexpr const char* STREAM_RESPONSE_HEADER =
+    "HTTP/1.1 200 OK\r\n"
+    "Connection: close\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Pragma: no-cache\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=mjpegstream\r\n\r\n";
+
+constexpr const char* UNAUTHORIZED_RESPONSE =
+    "HTTP/1.1 401 Unauthorized\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n\r\n"
+    "Invalid or expired token";
+
+constexpr const char* BAD_REQUEST_RESPONSE =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n\r\n"
+    "Invalid request";
+
+constexpr const char* NOT_FOUND_RESPONSE =
+    "HTTP/1.1 404 Not Found\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n\r\n"
+    "Unknown camera";
+
+}
+
+StreamServer::Reactor::~Reactor() {
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
+}
+
+StreamServer::StreamServer(std::vector<StreamSource> sources, SSL_CTX* ssl_ctx,
+                           TokenValidator validate_token, int num_threads)
+    : sources_(std::move(sources)), ssl_ctx_(ssl_ctx), validate_token_(std::move(validate_token)) {
+
+    if (sources_.empty()) {
+        throw std::runtime_error("Stream server needs at least one camera");
+    }
+
+    num_threads = std::max(1, num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+        auto reactor = std::make_unique<Reactor>();
+        reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (reactor->epoll_fd < 0 || reactor->wake_fd < 0) {
+            throw std::runtime_error("Failed to create stream reactor: " + std::string(strerror(errno)));
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = reactor->wake_fd;
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->wake_fd, &ev) < 0) {
+            throw std::runtime_error("Failed to register stream reactor wakeup: " + std::string(strerror(errno)));
+        }
+        reactors_.push_back(std::move(reactor));
+    }
+}
+
+StreamServer::~StreamServer() {
+    Stop();
+}
+
+bool StreamServer::Start(int port) {
+    if (running_) {
+        return true;
+    }
+
+    INFO_LOG("Starting " + std::string(ssl_ctx_ ? "HTTPS" : "HTTP") + " stream server on port " +
+             std::to_string(port) + " with " + std::to_string(reactors_.size()) + " reactor thread(s)");
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        ERROR_LOG("Failed to create socket");
+        return false;
+    }
+
+    // Set socket options to allow reuse of address
+    int opt = 1;
+    if (setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        ERROR_LOG("Failed to set socket options");
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) < 0) {
+        ERROR_LOG("Failed to bind socket: " + std::string(strerror(errno)));
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    if (listen(listen_fd_, SOMAXCONN) < 0) {
+        ERROR_LOG("Failed to listen on socket: " + std::string(strerror(errno)));
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    // Every reactor watches the listening socket, EPOLLEXCLUSIVE wakes only one per connection
+    for (auto& reactor : reactors_) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.fd = listen_fd_;
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) {
+            ERROR_LOG("Failed to register listening socket: " + std::string(strerror(errno)));
+            for (auto& registered : reactors_) {
+                epoll_ctl(registered->epoll_fd, EPOLL_CTL_DEL, listen_fd_, nullptr);
+            }
+            close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+    }
+
+    running_ = true;
+    for (auto& reactor : reactors_) {
+        reactor->thread = std::thread(&StreamServer::ReactorLoop, this, reactor.get());
+    }
+
+    INFO_LOG("MJPEG stream server started");
+    return true;
+}
+
+void StreamServer::Stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    NotifyFrame();
+    for (auto& reactor : reactors_) {
+        if (reactor->thread.joinable()) {
+            reactor->thread.join();
+        }
+    }
+
+    for (auto& reactor : reactors_) {
+        epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, listen_fd_, nullptr);
+
+        std::vector<int> fds;
+        for (const auto& entry : reactor->clients) {
+            fds.push_back(entry.first);
+        }
+        for (int fd : fds) {
+            CloseClient(*reactor, fd);
+        }
+    }
+
+    close(listen_fd_);
+    listen_fd_ = -1;
+
+    INFO_LOG("MJPEG stream server stopped");
+}
+
+bool StreamServer::IsRunning() const {
+    return running_;
+}
+
+void StreamServer::NotifyFrame() {
+    const uint64_t one = 1;
+    for (auto& reactor : reactors_) {
+        if (write(reactor->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            WARN_LOG("Failed to wake stream reactor: " + std::string(strerror(errno)));
+        }
+    }
+}
+
+size_t StreamServer::ClientCount() const {
+    return client_count_;
+}
+
+void StreamServer::ReactorLoop(Reactor* reactor) {
+    epoll_event events[MAX_EVENTS];
+
+    while (running_) {
+        int count = epoll_wait(reactor->epoll_fd, events, MAX_EVENTS, EPOLL_TIMEOUT_MS);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ERROR_LOG("epoll_wait failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        for (int i = 0; i < count && running_; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                AcceptClients(*reactor);
+            } else if (fd == reactor->wake_fd) {
+                uint64_t value;
+                while (read(reactor->wake_fd, &value, sizeof(value)) > 0) {
+                }
+                QueueLatestFrame(*reactor);
+            } else {
+                HandleClientEvent(*reactor, fd, events[i].events);
+            }
+        }
+    }
+}
+
+void StreamServer::AcceptClients(Reactor& reactor) {
+    while (true) {
+        sockaddr_in client_addr{};
+        socklen_t client_len = sizeof(client_addr);
+        int fd = accept4(listen_fd_, reinterpret_cast<sockaddr*>(&client_addr), &client_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                WARN_LOG("Failed to accept client: " + std::string(strerror(errno)));
+            }
+            return;
+        }
+
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        auto client = std::make_unique<Client>();
+        client->socket = fd;
+
+        char addr[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &client_addr.sin_addr, addr, sizeof(addr));
+        client->peer = std::string(addr) + ":" + std::to_string(ntohs(client_addr.sin_port));
+
+        if (ssl_ctx_) {
+            client->ssl = SSL_new(ssl_ctx_);
+            if (!client->ssl) {
+                ERROR_LOG("Failed to create SSL structure");
+                close(fd);
+                continue;
+            }
+            SSL_set_fd(client->ssl, fd);
+            SSL_set_accept_state(client->ssl);
+            client->state = ClientState::HANDSHAKE;
+        } else {
+            client->state = ClientState::READ_REQUEST;
+        }
+
+        client->events = EPOLLIN | EPOLLRDHUP;
+        epoll_event ev{};
+        ev.events = client->events;
+        ev.data.fd = fd;
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ERROR_LOG("Failed to register client socket: " + std::string(strerror(errno)));
+            if (client->ssl) {
+                SSL_free(client->ssl);
+            }
+            close(fd);
+            continue;
+        }
+
+        INFO_LOG("New streaming client connected: " + client->peer);
+        reactor.clients.emplace(fd, std::move(client));
+        client_count_++;
+    }
+}
+
+void StreamServer::HandleClientEvent(Reactor& reactor, int fd, uint32_t events) {
+    auto it = reactor.clients.find(fd);
+    if (it == reactor.clients.end()) {
+        return;
+    }
+    Client& client = *it->second;
+
+    bool ok = !(events & (EPOLLERR | EPOLLHUP));
+    if (ok) {
+        switch (client.state) {
+            case ClientState::HANDSHAKE:
+                ok = ContinueHandshake(client);
+                break;
+            case ClientState::READ_REQUEST:
+                ok = ReadRequest(client);
+                break;
+            case ClientState::STREAMING:
+            case ClientState::CLOSING:
+                if (events & (EPOLLIN | EPOLLRDHUP)) {
+                    ok = DrainInput(client);
+                }
+                break;
+        }
+    }
+    if (ok && (events & EPOLLOUT)) {
+        ok = FlushWrites(client);
+    }
+
+    if (!ok || (client.state == ClientState::CLOSING && client.write_queue.empty())) {
+        CloseClient(reactor, fd);
+        return;
+    }
+    if (!UpdateInterest(reactor, client)) {
+        CloseClient(reactor, fd);
+    }
+}
+
+void StreamServer::QueueLatestFrame(Reactor& reactor) {
+    std::vector<EncodedFramePtr> latest(sources_.size());
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        latest[i] = sources_[i].broadcaster->Latest();
+    }
+
+    std::vector<int> failed;
+    for (auto& entry : reactor.clients) {
+        Client& client = *entry.second;
+        if (client.state != ClientState::STREAMING || !latest[client.source]) {
+            continue;
+        }
+
+        QueueFrame(client, latest[client.source]);
+        if (!FlushWrites(client) || !UpdateInterest(reactor, client)) {
+            failed.push_back(entry.first);
+        }
+    }
+
+    for (int fd : failed) {
+        CloseClient(reactor, fd);
+    }
+}
+
+void StreamServer::CloseClient(Reactor& reactor, int fd) {
+    auto it = reactor.clients.find(fd);
+    if (it == reactor.clients.end()) {
+        return;
+    }
+
+    Client& client = *it->second;
+    epoll_ctl(reactor.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    if (client.ssl) {
+        // Best effort, the socket is non-blocking so this never waits on the peer
+        SSL_shutdown(client.ssl);
+        SSL_free(client.ssl);
+        ERR_clear_error();
+    }
+    close(fd);
+
+    DEBUG_LOG("Streaming client disconnected: " + client.peer);
+    reactor.clients.erase(it);
+    client_count_--;
+}
+
+bool StreamServer::UpdateInterest(Reactor& reactor, Client& client) {
+    uint32_t events = EPOLLIN | EPOLLRDHUP;
+    if (!client.write_queue.empty() || client.ssl_want_write) {
+        events |= EPOLLOUT;
+    }
+    if (events == client.events) {
+        return true;
+    }
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = client.socket;
+    if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_MOD, client.socket, &ev) < 0) {
+        ERROR_LOG("Failed to update client socket events: " + std::string(strerror(errno)));
+        return false;
+    }
+    client.events = events;
+    return true;
+}
+
+bool StreamServer::ContinueHandshake(Client& client) {
+    int rc = SSL_accept(client.ssl);
+    if (rc == 1) {
+        client.ssl_want_write = false;
+        client.state = ClientState::READ_REQUEST;
+        DEBUG_LOG("SSL connection established with " + client.peer);
+
+        // The request may already be buffered behind the handshake
+        return ReadRequest(client);
+    }
+
+    int err = SSL_get_error(client.ssl, rc);
+    if (err == SSL_ERROR_WANT_READ) {
+        client.ssl_want_write = false;
+        return true;
+    }
+    if (err == SSL_ERROR_WANT_WRITE) {
+        client.ssl_want_write = true;
+        return true;
+    }
+
+    DEBUG_LOG("SSL handshake failed for " + client.peer);
+    ERR_clear_error();
+    return false;
+}
+
+bool StreamServer::ReadRequest(Client& client) {
+    char buffer[4096];
+    while (true) {
+        ssize_t bytes_read = ReadSome(client, buffer, sizeof(buffer));
+        if (bytes_read < 0) {
+            return false;
+        }
+        if (bytes_read == 0) {
+            break;
+        }
+
+        client.request.append(buffer, bytes_read);
+        if (client.request.size() > MAX_REQUEST_SIZE) {
+            DEBUG_LOG("HTTP request too large from " + client.peer);
+            return false;
+        }
+    }
+
+    // Wait for the rest of the headers
+    if (client.request.find("\r\n\r\n") == std::string::npos) {
+        return true;
+    }
+    return HandleRequest(client);
+}
+
+bool StreamServer::HandleRequest(Client& client) {
+    std::map<std::string, std::string> headers;
+    std::string path;
+    if (!ParseHttpRequest(client.request, headers, path)) {
+        DEBUG_LOG("Invalid HTTP request from " + client.peer);
+        QueueText(client, BAD_REQUEST_RESPONSE);
+        client.state = ClientState::CLOSING;
+        return FlushWrites(client);
+    }
+
+    // Extract token from query string
+    std::string token = QueryParameter(path, "token");
+    if (!validate_token_ || !validate_token_(token)) {
+        DEBUG_LOG("Rejected streaming client " + client.peer + ": invalid token");
+        QueueText(client, UNAUTHORIZED_RESPONSE);
+        client.state = ClientState::CLOSING;
+        return FlushWrites(client);
+    }
+
+    std::string camera = QueryParameter(path, "camera");
+    if (!camera.empty()) {
+        auto it = std::find_if(sources_.begin(), sources_.end(),
+                               [&camera](const StreamSource& source) { return source.camera == camera; });
+        if (it == sources_.end()) {
+            DEBUG_LOG("Rejected streaming client " + client.peer + ": unknown camera " + camera);
+            QueueText(client, NOT_FOUND_RESPONSE);
+            client.state = ClientState::CLOSING;
+            return FlushWrites(client);
+        }
+        client.source = static_cast<size_t>(it - sources_.begin());
+    }
+
+    client.request.clear();
+    client.request.shrink_to_fit();
+    client.state = ClientState::STREAMING;
+    QueueText(client, STREAM_RESPONSE_HEADER);
+    if (EncodedFramePtr frame = sources_[client.source].broadcaster->Latest()) {
+        QueueFrame(client, frame);
+    }
+
+    INFO_LOG("Streaming camera " + sources_[client.source].camera + " to client " + client.peer);
+    return FlushWrites(client);
+}
+
+bool StreamServer::DrainInput(Client& client) {
+    // Viewers don't send anything after the request, this only detects disconnects
+    char buffer[1024];
+    while (true) {
+        ssize_t bytes_read = ReadSome(client, buffer, sizeof(buffer));
+        if (bytes_read < 0) {
+            return false;
+        }
+        if (bytes_read == 0) {
+            return true;
+        }
+    }
+}
+
+bool StreamServer::FlushWrites(Client& client) {
+    while (!client.write_queue.empty()) {
+        OutChunk& chunk = client.write_queue.front();
+        chunk.write_started = true;
+        ssize_t written = WriteChunk(client, chunk);
+        if (written < 0) {
+            return false;
+        }
+        if (written == 0) {
+            // Socket is full, resume on EPOLLOUT
+            return true;
+        }
+
+        chunk.offset += written;
+        if (chunk.offset >= ChunkSize(chunk)) {
+            if (chunk.frame) {
+                client.queued_frames--;
+            }
+            client.write_queue.pop_front();
+        }
+    }
+    return true;
+}
+
+void StreamServer::QueueText(Client& client, const std::string& text) {
+    OutChunk chunk;
+    chunk.text = text;
+    client.write_queue.push_back(std::move(chunk));
+}
+
+void StreamServer::QueueFrame(Client& client, const EncodedFramePtr& frame) {
+    if (frame->sequence <= client.last_sequence) {
+        return;
+    }
+
+    // A queued frame that was never handed to a write is stale, replace it with the newer one.
+    // Once attempted it stays, even at offset 0 OpenSSL may hold it for a WANT_WRITE retry.
+    if (!client.write_queue.empty()) {
+        OutChunk& back = client.write_queue.back();
+        if (back.frame && !back.write_started) {
+            back.frame = frame;
+            client.last_sequence = frame->sequence;
+            return;
+        }
+    }
+
+    // Slow client, skip this frame
+    if (client.queued_frames >= MAX_QUEUED_FRAMES) {
+        return;
+    }
+
+    OutChunk chunk;
+    chunk.frame = frame;
+    client.write_queue.push_back(std::move(chunk));
+    client.queued_frames++;
+    client.last_sequence = frame->sequence;
+}
+
+ssize_t StreamServer::ReadSome(Client& client, char* buffer, size_t size) {
+    if (client.ssl) {
+        int rc = SSL_read(client.ssl, buffer, static_cast<int>(size));
+        if (rc > 0) {
+            return rc;
+        }
+        int err = SSL_get_error(client.ssl, rc);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            return 0;
+        }
+        ERR_clear_error();
+        return -1;
+    }
+
+    ssize_t rc = recv(client.socket, buffer, size, 0);
+    if (rc > 0) {
+        return rc;
+    }
+    if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return -1;
+}
+
+ssize_t StreamServer::WriteChunk(Client& client, const OutChunk& chunk) {
+    iovec iov[3];
+    int iov_count = ChunkSegments(chunk, iov);
+
+    if (client.ssl) {
+        // TLS writes one contiguous segment at a time; a retry after WANT_WRITE
+        // passes the same buffer since the offset only moves on success
+        int rc = SSL_write(client.ssl, iov[0].iov_base, static_cast<int>(iov[0].iov_len));
+        if (rc > 0) {
+            return rc;
+        }
+        int err = SSL_get_error(client.ssl, rc);
+        if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
+            return 0;
+        }
+        ERR_clear_error();
+        return -1;
+    }
+
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+    ssize_t rc = sendmsg(client.socket, &msg, MSG_NOSIGNAL);
+    if (rc >= 0) {
+        return rc;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+    }
+    return -1;
+}
+
+size_t StreamServer::ChunkSize(const OutChunk& chunk) {
+    if (!chunk.frame) {
+        return chunk.text.size();
+    }
+    return chunk.frame->part_header.size() + chunk.frame->jpeg.size() + EncodedFrame::PART_TRAILER_SIZE;
+}
+
+int StreamServer::ChunkSegments(const OutChunk& chunk, iovec* iov) {
+    if (!chunk.frame) {
+        iov[0].iov_base = const_cast<char*>(chunk.text.data() + chunk.offset);
+        iov[0].iov_len = chunk.text.size() - chunk.offset;
+        return 1;
+    }
+
+    const EncodedFrame& frame = *chunk.frame;
+    const std::pair<const char*, size_t> parts[] = {
+        {frame.part_header.data(), frame.part_header.size()},
+        {reinterpret_cast<const char*>(frame.jpeg.data()), frame.jpeg.size()},
+        {EncodedFrame::PART_TRAILER, EncodedFrame::PART_TRAILER_SIZE}
+    };
+
+    size_t skip = chunk.offset;
+    int count = 0;
+    for (const auto& part : parts) {
+        if (skip >= part.second) {
+            skip -= part.second;
+            continue;
+        }
+        iov[count].iov_base = const_cast<char*>(part.first + skip);
+        iov[count].iov_len = part.second - skip;
+        skip = 0;
+        count++;
+    }
+    return count;
+}
+
+bool StreamServer::ParseHttpRequest(const std::string& request, std::map<std::string, std::string>& headers,
+                                    std::string& path) {
+    std::istringstream stream(request);
+    std::string line;
+
+    // Parse request line
+    if (!std::getline(stream, line)) {
+        return false;
+    }
+
+    std::istringstream request_line(line);
+    std::string method, http_version;
+
+    if (!(request_line >> method >> path >> http_version)) {
+        return false;
+    }
+
+    // Parse headers
+    while (std::getline(stream, line) && line != "\r") {
+        size_t colon_pos = line.find(':');
+        if (colon_pos != std::string::npos) {
+            std::string name = line.substr(0, colon_pos);
+            std::string value = line.substr(colon_pos + 1);
+
+            // Trim whitespace
+            value.erase(0, value.find_first_not_of(" \t"));
+            value.erase(value.find_last_not_of("\r\n") + 1);
+
+            headers[name] = value;
+        }
+    }
+
+    return true;
+}
+
+std::string StreamServer::QueryParameter(const std::string& path, const std::string& name) {
+    size_t query = path.find('?');
+    if (query == std::string::npos) {
+        return "";
+    }
+
+    size_t pos = query + 1;
+    while (pos < path.size()) {
+        size_t end = path.find('&', pos);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        size_t eq = path.find('=', pos);
+        if (eq != std::string::npos && eq < end && path.compare(pos, eq - pos, name) == 0) {
+            return path.substr(eq + 1, end - eq - 1);
+        }
+        pos = end + 1;
+    }
+    return "";
+}
@@ -0,0 +1,311 @@
+#include "v4l2_capture.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+V4L2Capture::V4L2Capture(const std::string& device, int width, int height, int fps,
+                         PixelFormat format, unsigned int buffer_count)
+    : device_(device), width_(width), height_(height), fps_(fps),
+      format_(format), buffer_count_(buffer_count) {
+}
+
+V4L2Capture::~V4L2Capture() {
+    Close();
+}
+
+bool V4L2Capture::Open() {
+    INFO_LOG("Opening V4L2 device: " + device_);
+
+    fd_ = open(device_.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        ERROR_LOG("Failed to open " + device_ + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    v4l2_capability cap{};
+    if (!Ioctl(VIDIOC_QUERYCAP, &cap)) {
+        ERROR_LOG(device_ + " is not a V4L2 device");
+        Close();
+        return false;
+    }
+
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) {
+        ERROR_LOG(device_ + " does not support streaming video capture");
+        Close();
+        return false;
+    }
+
+    if (!ConfigureFormat()) {
+        Close();
+        return false;
+    }
+    ConfigureFrameRate();
+
+    if (!MapBuffers()) {
+        Close();
+        return false;
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (!Ioctl(VIDIOC_STREAMON, &type)) {
+        ERROR_LOG("Failed to start streaming on " + device_ + ": " + std::string(strerror(errno)));
+        Close();
+        return false;
+    }
+    streaming_ = true;
+
+    INFO_LOG("V4L2 capture started: " + std::to_string(width_) + "x" + std::to_string(height_) + " @ " +
+             std::to_string(fps_) + " FPS, " + (format_ == PixelFormat::MJPEG ? "MJPEG" : "YUYV") +
+             ", " + std::to_string(buffers_.size()) + " buffers");
+    return true;
+}
+
+void V4L2Capture::Close() {
+    if (fd_ < 0) {
+        return;
+    }
+
+    if (streaming_) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        Ioctl(VIDIOC_STREAMOFF, &type);
+        streaming_ = false;
+    }
+    held_index_ = -1;
+    held_bytes_ = 0;
+    unqueued_.clear();
+
+    UnmapBuffers();
+    close(fd_);
+    fd_ = -1;
+}
+
+bool V4L2Capture::IsOpened() const {
+    return fd_ >= 0 && streaming_;
+}
+
+bool V4L2Capture::Grab(int timeout_ms) {
+    if (!IsOpened()) {
+        return false;
+    }
+
+    // Hand the previous buffer back so the driver can keep filling the ring
+    if (held_index_ >= 0) {
+        unqueued_.push_back(held_index_);
+        held_index_ = -1;
+        held_bytes_ = 0;
+    }
+    // A buffer that failed to requeue stays ours until it goes back, otherwise
+    // the ring shrinks for good
+    unqueued_.erase(std::remove_if(unqueued_.begin(), unqueued_.end(),
+                                   [this](int index) { return Requeue(index); }),
+                    unqueued_.end());
+    if (unqueued_.size() >= buffers_.size()) {
+        return false;
+    }
+
+    pollfd pfd{fd_, POLLIN, 0};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc == 0) {
+        WARN_LOG("Timed out waiting for frame from " + device_);
+        return false;
+    }
+    if (rc < 0) {
+        if (errno != EINTR) {
+            ERROR_LOG("poll failed on " + device_ + ": " + std::string(strerror(errno)));
+        }
+        return false;
+    }
+
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (!Ioctl(VIDIOC_DQBUF, &buf)) {
+        if (errno != EAGAIN) {
+            ERROR_LOG("Failed to dequeue buffer from " + device_ + ": " + std::string(strerror(errno)));
+        }
+        return false;
+    }
+
+    if ((buf.flags & V4L2_BUF_FLAG_ERROR) || buf.bytesused == 0) {
+        WARN_LOG("Driver returned a corrupted frame, dropping it");
+        if (!Requeue(static_cast<int>(buf.index))) {
+            unqueued_.push_back(static_cast<int>(buf.index));
+        }
+        return false;
+    }
+
+    held_index_ = static_cast<int>(buf.index);
+    held_bytes_ = buf.bytesused;
+    return true;
+}
+
+cv::Mat V4L2Capture::View() const {
+    if (held_index_ < 0) {
+        return cv::Mat();
+    }
+
+    void* start = buffers_[held_index_].start;
+    if (format_ == PixelFormat::MJPEG) {
+        return cv::Mat(1, static_cast<int>(held_bytes_), CV_8UC1, start);
+    }
+    return cv::Mat(height_, width_, CV_8UC2, start, bytes_per_line_);
+}
+
+const uint8_t* V4L2Capture::Data() const {
+    if (held_index_ < 0) {
+        return nullptr;
+    }
+    return static_cast<const uint8_t*>(buffers_[held_index_].start);
+}
+
+size_t V4L2Capture::Size() const {
+    return held_bytes_;
+}
+
+V4L2Capture::PixelFormat V4L2Capture::Format() const {
+    return format_;
+}
+
+int V4L2Capture::Width() const {
+    return width_;
+}
+
+int V4L2Capture::Height() const {
+    return height_;
+}
+
+int V4L2Capture::FPS() const {
+    return fps_;
+}
+
+bool V4L2Capture::Ioctl(unsigned long request, void* arg) const {
+    int rc;
+    do {
+        rc = ioctl(fd_, request, arg);
+    } while (rc < 0 && errno == EINTR);
+    return rc >= 0;
+}
+
+bool V4L2Capture::ConfigureFormat() {
+    const uint32_t pixel_format = format_ == PixelFormat::MJPEG ? V4L2_PIX_FMT_MJPEG : V4L2_PIX_FMT_YUYV;
+
+    v4l2_format fmt{};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = width_;
+    fmt.fmt.pix.height = height_;
+    fmt.fmt.pix.pixelformat = pixel_format;
+    fmt.fmt.pix.field = V4L2_FIELD_ANY;
+    if (!Ioctl(VIDIOC_S_FMT, &fmt)) {
+        ERROR_LOG("Failed to set format on " + device_ + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    if (fmt.fmt.pix.pixelformat != pixel_format) {
+        ERROR_LOG(device_ + " does not support the requested pixel format");
+        return false;
+    }
+
+    if (static_cast<int>(fmt.fmt.pix.width) != width_ || static_cast<int>(fmt.fmt.pix.height) != height_) {
+        WARN_LOG("Requested resolution (" + std::to_string(width_) + "x" + std::to_string(height_) +
+                 ") not supported. Using " + std::to_string(fmt.fmt.pix.width) + "x" +
+                 std::to_string(fmt.fmt.pix.height) + " instead.");
+        width_ = fmt.fmt.pix.width;
+        height_ = fmt.fmt.pix.height;
+    }
+    bytes_per_line_ = fmt.fmt.pix.bytesperline ? fmt.fmt.pix.bytesperline : static_cast<size_t>(width_) * 2;
+    return true;
+}
+
+void V4L2Capture::ConfigureFrameRate() {
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    parm.parm.capture.timeperframe.numerator = 1;
+    parm.parm.capture.timeperframe.denominator = fps_;
+    if (!Ioctl(VIDIOC_S_PARM, &parm)) {
+        WARN_LOG("Failed to set frame rate on " + device_ + ", using the driver default");
+        return;
+    }
+
+    const v4l2_fract& tpf = parm.parm.capture.timeperframe;
+    if (tpf.numerator > 0 && tpf.denominator > 0) {
+        int actual_fps = static_cast<int>(tpf.denominator / tpf.numerator);
+        if (actual_fps > 0 && actual_fps != fps_) {
+            WARN_LOG("Requested FPS (" + std::to_string(fps_) + ") not supported. Using " +
+                     std::to_string(actual_fps) + " instead.");
+            fps_ = actual_fps;
+        }
+    }
+}
+
+bool V4L2Capture::MapBuffers() {
+    v4l2_requestbuffers req{};
+    req.count = buffer_count_;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (!Ioctl(VIDIOC_REQBUFS, &req)) {
+        ERROR_LOG(device_ + " does not support mmap streaming: " + std::string(strerror(errno)));
+        return false;
+    }
+    if (req.count < 2) {
+        ERROR_LOG("Insufficient buffer memory on " + device_);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < req.count; ++i) {
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (!Ioctl(VIDIOC_QUERYBUF, &buf)) {
+            ERROR_LOG("Failed to query buffer " + std::to_string(i) + " on " + device_);
+            return false;
+        }
+
+        void* start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, buf.m.offset);
+        if (start == MAP_FAILED) {
+            ERROR_LOG("Failed to map buffer " + std::to_string(i) + ": " + std::string(strerror(errno)));
+            return false;
+        }
+        buffers_.push_back({start, buf.length});
+
+        if (!Requeue(static_cast<int>(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void V4L2Capture::UnmapBuffers() {
+    for (auto& buffer : buffers_) {
+        munmap(buffer.start, buffer.length);
+    }
+    buffers_.clear();
+
+    // Release the driver side of the ring
+    v4l2_requestbuffers req{};
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    Ioctl(VIDIOC_REQBUFS, &req);
+}
+
+bool V4L2Capture::Requeue(int index) {
+    v4l2_buffer buf{};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = static_cast<uint32_t>(index);
+    if (!Ioctl(VIDIOC_QBUF, &buf)) {
+        ERROR_LOG("Failed to queue buffer " + std::to_string(index) + " on " + device_ + ": " +
+                  std::string(strerror(errno)));
+        return false;
+    }
+    return true;
+}